@@ -2,16 +2,33 @@
 
 
 #include <iostream>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <future>
+#include <functional>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <filesystem>
+#include <charconv>
+#include <string_view>
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/chrono/thread_clock.hpp>
 #include <boost/iostreams/stream.hpp>
 #include <boost/iostreams/filtering_streambuf.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
 #include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
 #include <boost/locale.hpp>
+#include <boost/uuid/detail/sha1.hpp>
 
 
 #include "Basic/nlohmann/json.hpp"
-//#include "Basic/OpenMP.h"
+#include "Basic/OpenMP.h"
 #include "Basic/Shore.h"
 #include "Basic/ModelStat.h"
 
@@ -72,323 +89,2364 @@ namespace WBSF
 	}
 
 
-	static CLocation GetLocation(const std::string& metadata)
+	//number of threads used by internal parallel loops: from the instance, or from the global NbCPU
+	static int GetNbCPU(int CPU = CWeatherGeneratorInit::GLOBAL_NB_CPU)
 	{
-		CLocation location;
+		if (CPU == CWeatherGeneratorInit::GLOBAL_NB_CPU)
+			CPU = pGLOBAL_DLL_DATA ? pGLOBAL_DLL_DATA->m_nb_CPU : 0;
 
+		if (CPU <= 0)
+			CPU = max(1, omp_get_max_threads() + CPU);
 
+		return min(CPU, omp_get_max_threads());
+	}
 
-		//xml or json????
-		nlohmann::json data = nlohmann::json::parse(metadata);
-		//auto l = data.at("Location");
-		//location.m_ID = l.at("ID");
+	//boost iostreams device that send each buffer to the caller.
+	//When compressed, each buffer is sent as an independent gzip member: a flush gives
+	//the caller decompressible bytes immediately and the concatenated members are a valid gzip stream.
+	class CChunkSink
+	{
+	public:
 
-		location.m_ID = data["Location"]["ID"];
-		location.m_name = data["Location"]["Name"];
-		location.m_lat = data["Location"]["Latitude"];
-		location.m_lon = data["Location"]["Longitude"];
-		location.m_elev = data["Location"]["Elevation"];
+		typedef char char_type;
+		typedef boost::iostreams::sink_tag category;
 
-		//pugi::xml_document doc;
-		//doc.load_string(metadata.c_str());
-		//pugi::xml_node node = doc.root().child("Metadata").child(CLocationVector::XML_FLAG);
-		//location.read_xml(node);
+		static const std::streamsize CHUNK_SIZE = 1024 * 1024;
 
-		return location;
-	}
+		CChunkSink(const std::function<void(const std::string&)>& sink, bool compress = false) : m_pSink(&sink), m_compress(compress) {}
 
+		std::streamsize write(const char* s, std::streamsize n)
+		{
+			if (m_compress)
+			{
+				std::string member;
+				{
+					boost::iostreams::filtering_ostream out;
+					out.push(boost::iostreams::gzip_compressor());
+					out.push(boost::iostreams::back_inserter(member));
+					out.write(s, n);
+				}
 
-	//******************************************************************************************************************************
-	//
-	const char* CGlobalDLLData::NAME[NB_PAPAMS] = { "ModelsPath", "Shore", "DEM", "DailyCacheSize" };
+				(*m_pSink)(member);
+			}
+			else
+			{
+				(*m_pSink)(std::string(s, size_t(n)));
+			}
 
+			return n;
+		}
 
+	protected:
 
-	void CGlobalDLLData::clear()
+		const std::function<void(const std::string&)>* m_pSink;
+		bool m_compress;
+	};
+
+	//gzip data if requested
+	static std::string GetData(std::stringstream& stream, bool compress)
 	{
-		m_model_path.clear();
-		m_shore_file_path.clear();
-		m_DEM_file_path.clear();
-		m_daily_cache_size = 200;
+		boost::iostreams::filtering_streambuf<boost::iostreams::input> out;
+		if (compress)
+		{
+			boost::iostreams::gzip_params p;
+			p.file_name = "data.csv";
+			out.push(boost::iostreams::gzip_compressor(p));
+		}
+		out.push(stream);
+
+		std::stringstream compressed;
+		boost::iostreams::copy(out, compressed);
+
+		return compressed.str();
 	}
 
+	static nlohmann::json GetLocationJSON(const CLocation& location)
+	{
+		nlohmann::json l =
+		{
+			{"ID", location.m_ID},
+			{"Name", location.m_name},
+			{"Latitude", location.m_lat},
+			{"Longitude", location.m_lon},
+			{"Elevation", location.m_elev}
+		};
+
+		return l;
+	}
 
-	ERMsg CGlobalDLLData::parse(const std::string& str_init)
+	//Thread safe LRU cache of CTeleIO, bounded by bytes
+	class CTeleIOCache
 	{
-		ERMsg msg;
+	public:
 
-		clear();
+		CTeleIOCache(size_t max_size) :
+			m_max_size(max_size),
+			m_size(0),
+			m_hits(0),
+			m_misses(0)
+		{
+		}
 
-		vector<string> args = Tokenize(str_init, "&");
-		for (size_t i = 0; i < args.size(); i++)
+		bool get(const std::string& key, CTeleIO& IO)
 		{
-			string::size_type pos = args[i].find('=');
-			if (pos != string::npos)
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			auto it = m_map.find(key);
+			if (it == m_map.end())
 			{
-				string key = args[i].substr(0, pos);
-				string value = args[i].substr(pos + 1);
+				m_misses++;
+				return false;
+			}
 
-				//auto it = std::find(begin(NAME), end(NAME), MakeUpper(option[0]));
-				//string str1 = option[0];
-				auto it = std::find_if(begin(NAME), end(NAME), [&str1 = key](const auto& str2) { return boost::iequals(str1, str2); });
-				if (it != end(NAME))
-				{
-					size_t o = distance(begin(NAME), it);
-					switch (o)
-					{
-					case MODELS_PATH: m_model_path = value; break;
-					case SHORE: m_shore_file_path = value; break;
-					case DEM: m_DEM_file_path = value; break;
-					case DAILY_CACHE_SIZE: m_daily_cache_size = std::atoi(value.c_str()); break;
-					default: assert(false);
-					}
-				}
-				else
-				{
-					msg.ajoute("Invalid options in argument " + to_string(i + 1) + "( " + args[i] + ")");
-				}
+			//move to front: most recently used
+			m_list.splice(m_list.begin(), m_list, it->second);
+			IO = it->second->m_output;
+			m_hits++;
+
+			return true;
+		}
+
+		void set(const std::string& key, const CTeleIO& IO)
+		{
+			CEntry entry = { key, IO };
+
+			size_t size = GetSize(entry);
+			if (size > m_max_size)
+				return;
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			auto it = m_map.find(key);
+			if (it != m_map.end())
+			{
+				m_size -= GetSize(*it->second);
+				m_list.erase(it->second);
+				m_map.erase(it);
 			}
-			else
+
+			m_list.push_front(std::move(entry));
+			m_map[key] = m_list.begin();
+			m_size += size;
+
+			//remove least recently used
+			while (m_size > m_max_size)
 			{
-				msg.ajoute("error in argument " + to_string(i + 1) + "( " + args[i] + ")");
+				m_size -= GetSize(m_list.back());
+				m_map.erase(m_list.back().m_key);
+				m_list.pop_back();
 			}
 		}
 
-		return msg;
-	};
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_list.clear();
+			m_map.clear();
+			m_size = 0;
+		}
 
-	std::string CBioSIM_API_GlobalData::InitGlobalData(const std::string& str_init)
-	{
-		ERMsg msg;
+		size_t hits()const { return m_hits; }
+		size_t misses()const { return m_misses; }
 
-		GDALAllRegister();
+	protected:
 
-		if (pGLOBAL_DLL_DATA.get() == nullptr)
-			pGLOBAL_DLL_DATA.reset(new CGlobalDLLData);
+		struct CEntry
+		{
+			std::string m_key;
+			CTeleIO m_output;
+		};
 
-		msg = pGLOBAL_DLL_DATA->parse(str_init);
+		static size_t GetSize(const CTeleIO& IO)
+		{
+			return IO.m_msg.size() + IO.m_comment.size() + IO.m_metadata.size() + IO.m_data.size() + IO.m_timing.size();
+		}
 
-		if (msg)
+		static size_t GetSize(const CEntry& entry)
 		{
-			try
-			{
-				CCallback callback;
+			return entry.m_key.size() + GetSize(entry.m_output);
+		}
 
-				if (!pGLOBAL_DLL_DATA->m_model_path.empty())
-				{
-					if (!WBSF::IsPathEndOk(pGLOBAL_DLL_DATA->m_model_path))
-						pGLOBAL_DLL_DATA->m_model_path += "/";
-				}
+		typedef std::list<CEntry> CTeleIOList;
+
+		std::mutex m_mutex;
+		CTeleIOList m_list;
+		std::unordered_map<std::string, CTeleIOList::iterator> m_map;
+		size_t m_max_size;
+		size_t m_size;
+		std::atomic<size_t> m_hits;
+		std::atomic<size_t> m_misses;
+	};
 
 
-				msg += CShore::SetShore(pGLOBAL_DLL_DATA->m_shore_file_path);
+	//Coalesce identical concurrent requests: the first caller compute the result, the others wait and share it
+	class CSingleFlight
+	{
+	public:
 
+		CTeleIO Do(const std::string& key, const std::function<CTeleIO()>& compute)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
 
-				if (!pGLOBAL_DLL_DATA->m_DEM_file_path.empty())
-				{
-					pGLOBAL_DLL_DATA->m_pDEM.reset(new CGDALDatasetEx);
-					msg += pGLOBAL_DLL_DATA->m_pDEM->OpenInputImage(pGLOBAL_DLL_DATA->m_DEM_file_path);
-				}
+			auto it = m_calls.find(key);
+			if (it != m_calls.end())
+			{
+				//same request in progress: wait for its result
+				std::shared_future<CTeleIO> result = it->second;
+				lock.unlock();
 
+				return result.get();
+			}
+
+			std::promise<CTeleIO> promise;
+			m_calls[key] = promise.get_future().share();
+			lock.unlock();
 
+			CTeleIO output;
+			try
+			{
+				output = compute();
+				promise.set_value(output);
 			}
 			catch (...)
 			{
-				int i;
-				i = 0;
+				promise.set_exception(std::current_exception());
+				lock.lock();
+				m_calls.erase(key);
+				throw;
 			}
+
+			lock.lock();
+			m_calls.erase(key);
+
+			return output;
 		}
 
-		return get_string(msg);
-	}
+	protected:
 
+		std::mutex m_mutex;
+		std::unordered_map<std::string, std::shared_future<CTeleIO>> m_calls;
+	};
 
 
+	//CPU time of the calling thread since start, in seconds
+	class CThreadCPUTimer
+	{
+	public:
 
+		CThreadCPUTimer()
+		{
+			start();
+		}
 
-	//******************************************************************************************************************************
+		void start()
+		{
+			m_start = boost::chrono::thread_clock::now();
+		}
 
-	//"DefaultEndpointsProtocol","EndpointSuffix",
-	const char* CWeatherGeneratorInit::NAME[NB_PAPAMS] = { "Normals", "Daily", "Hourly", "GRIBS" };
+		double elapsed()const
+		{
+			return boost::chrono::duration<double>(boost::chrono::thread_clock::now() - m_start).count();
+		}
 
-	CWeatherGeneratorInit::CWeatherGeneratorInit()
-	{
-		clear();
-	}
+	protected:
 
-	void CWeatherGeneratorInit::clear()
-	{
-		m_normal_name.clear();
-		m_daily_name.clear();
-	}
+		boost::chrono::thread_clock::time_point m_start;
+	};
 
-	ERMsg CWeatherGeneratorInit::parse(const std::string& str_init)
+	//Wall and CPU time of each phase of a call. Phases are started and stopped by the thread of the call only:
+	//a parallel phase is timed once around its parallel region, with the CPU time of the thread of the call.
+	//Threads of parallel regions add their own CPU time to the phases they work on, reported separately (ThreadCPU).
+	class CPhaseTimer
 	{
-		ERMsg msg;
+	public:
 
-		clear();
+		CPhaseTimer() :
+			m_total_start(std::chrono::steady_clock::now())
+		{
+		}
 
-		vector<string> args = Tokenize(str_init, "&");
-		for (size_t i = 0; i < args.size(); i++)
+		//stop the current phase and start a new one
+		void start(const std::string& phase)
 		{
-			string::size_type pos = args[i].find('=');
-			if (pos != string::npos)
-			{
-				string key = args[i].substr(0, pos);
-				string value = args[i].substr(pos + 1);
+			stop();
+			m_phase = phase;
+			m_start = std::chrono::steady_clock::now();
+			m_cpu_timer.start();
+
+			//phases are reported in the order they are started
+			std::lock_guard<std::mutex> lock(m_mutex);
+			get(phase);
+		}
 
-				//auto it = std::find(begin(NAME), end(NAME), MakeUpper(option[0]));
-				//string str1 = option[0];
-				auto it = std::find_if(begin(NAME), end(NAME), [&str1 = key](const auto& str2) { return boost::iequals(str1, str2); });
-				if (it != end(NAME))
-				{
-					size_t o = distance(begin(NAME), it);
-					switch (o)
-					{
-					case NORMALS: m_normal_name = value; break;
-					case DAILY: m_daily_name = value; break;
-					default: assert(false);
-					}
-				}
-				else
-				{
-					msg.ajoute("Invalid options in argument " + to_string(i + 1) + "( " + args[i] + ")");
-				}
+		void stop()
+		{
+			if (!m_phase.empty())
+			{
+				double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+				double cpu = m_cpu_timer.elapsed();
+
+				std::lock_guard<std::mutex> lock(m_mutex);
+				CTimes& times = get(m_phase);
+				times.m_wall += wall;
+				times.m_CPU += cpu;
+				times.m_bTimed = true;
+				m_phase.clear();
 			}
-			else
+		}
+
+		//add the CPU time of a thread to a phase, can be called from many threads
+		void add(const std::string& phase, double thread_CPU)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			CTimes& times = get(phase);
+			times.m_thread_CPU += thread_CPU;
+			times.m_bThreads = true;
+		}
+
+		//add the phases of a timer used by one thread of a parallel region: all its CPU time is thread CPU
+		void add(CPhaseTimer& other)
+		{
+			other.stop();
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (const auto& p : other.m_phases)
 			{
-				msg.ajoute("error in argument " + to_string(i + 1) + "( " + args[i] + ")");
+				CTimes& times = get(p.first);
+				times.m_thread_CPU += p.second.m_CPU + p.second.m_thread_CPU;
+				times.m_bThreads = true;
 			}
 		}
 
-		return msg;
-	};
+		nlohmann::json to_json()
+		{
+			stop();
 
+			double total_wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_total_start).count();
+			double total_CPU = m_total_cpu_timer.elapsed();
 
-	//******************************************************************************************************************************
+			std::lock_guard<std::mutex> lock(m_mutex);
 
+			nlohmann::json timing = nlohmann::json::array();
+			for (const auto& p : m_phases)
+			{
+				nlohmann::json phase = { {"Phase", p.first} };
+				if (p.second.m_bTimed)
+				{
+					phase["Wall"] = p.second.m_wall;
+					phase["CPU"] = p.second.m_CPU;
+				}
 
-	const char* CWeatherGeneratorOptions::PARAM_NAME[NB_PAPAMS] =
-	{
-		"VARIABLES", "SOURCE", "GENERATION", "REPLICATIONS",
-		"ID", "NAME", "LATITUDE", "LONGITUDE", "ELEVATION", "SLOPE", "ORIENTATION",
-		"NB_NEAREST_NEIGHBOR", "FIRST_YEAR", "LAST_YEAR","NB_YEARS",
-		"SEED", "NORMALS_INFO", "COMPRESS"
+				if (p.second.m_bThreads)
+					phase["ThreadCPU"] = p.second.m_thread_CPU;
+
+				timing.push_back(phase);
+			}
+
+			timing.push_back({ {"Phase", "Total"}, {"Wall", total_wall}, {"CPU", total_CPU} });
+
+			return timing;
+		}
+
+	protected:
+
+		struct CTimes
+		{
+			double m_wall = 0;
+			double m_CPU = 0;
+			double m_thread_CPU = 0;
+			bool m_bTimed = false;
+			bool m_bThreads = false;
+		};
+
+		CTimes& get(const std::string& phase)
+		{
+			auto it = std::find_if(m_phases.begin(), m_phases.end(), [&phase](const auto& p) { return p.first == phase; });
+			if (it == m_phases.end())
+				it = m_phases.insert(m_phases.end(), make_pair(phase, CTimes()));
+
+			return it->second;
+		}
+
+		std::mutex m_mutex;
+		std::chrono::steady_clock::time_point m_total_start;
+		CThreadCPUTimer m_total_cpu_timer;
+		std::chrono::steady_clock::time_point m_start;
+		CThreadCPUTimer m_cpu_timer;
+		std::string m_phase;
+		std::vector<std::pair<std::string, CTimes>> m_phases;
 	};
 
-	CWeatherGeneratorOptions::CWeatherGeneratorOptions()
+	//set the timing of this call, outside of the content (metadata)
+	static void SetTiming(CTeleIO& IO, CPhaseTimer& timer)
 	{
-		m_sourceType = 1;
-		m_generationType = 1;
-		m_variables = "TN+T+TX+P";
-		m_normals_info = "1991-2020";
-		m_latitude = -999;
-		m_longitude = -999;
-		m_elevation = -999;
-		m_slope = -999;
-		m_orientation = -999;
-		m_nb_nearest_neighbor = 4;
-		m_replications = 1;
-		m_nb_years = 1;
-		m_first_year = CTRef::GetCurrentTRef().GetYear();
-		m_last_year = CTRef::GetCurrentTRef().GetYear();
-		m_seed = 0;
-		m_compress = true;
+		IO.m_timing = timer.to_json().dump();
 	}
 
-	ERMsg CWeatherGeneratorOptions::parse(const string& str_options)
+	//******************************************************************************************************************************
+
+	//identity of a CTeleIO content without keeping a copy of it: SHA-1 digest (160 bits) of the metadata 
+	//and of the decompressed data, so the same content compressed or not have the same key.
+	//Compressed data is decompressed by chunks. Return an empty key for invalid compressed data.
+	static std::string GetHashKey(const CTeleIOView& IO)
 	{
-		ERMsg msg;
+		boost::uuids::detail::sha1 sha1;
 
-		vector<string> args = Tokenize(str_options, "&");
-		for (size_t i = 0; i < args.size(); i++)
+		uint64_t metadata_size = IO.m_metadata.size();
+		sha1.process_bytes(&metadata_size, sizeof(metadata_size));
+		sha1.process_bytes(IO.m_metadata.data(), IO.m_metadata.size());
+
+		if (IO.m_compress)
 		{
-			vector<string> option = Tokenize(args[i], "=");
-			if (option.size() == 2)
+			try
 			{
-				//auto it = std::find(begin(PARAM_NAME), end(PARAM_NAME), MakeUpper(option[0]));
-				auto it = std::find_if(begin(PARAM_NAME), end(PARAM_NAME), [&str1 = option[0]](const auto& str2) { return boost::iequals(str1, str2); });
-				if (it != end(PARAM_NAME))
-				{
-					size_t o = distance(begin(PARAM_NAME), it);
+				boost::iostreams::filtering_istreambuf in;
+				in.push(boost::iostreams::gzip_decompressor());
+				in.push(boost::iostreams::array_source(IO.m_data.data(), IO.m_data.size()));
+
+				vector<char> buffer(64 * 1024);
+				for (std::streamsize nb_read = in.sgetn(buffer.data(), buffer.size()); nb_read > 0; nb_read = in.sgetn(buffer.data(), buffer.size()))
+					sha1.process_bytes(buffer.data(), size_t(nb_read));
+			}
+			catch (const std::exception&)
+			{
+				return "";
+			}
+		}
+		else
+		{
+			sha1.process_bytes(IO.m_data.data(), IO.m_data.size());
+		}
+
+		//the digest type depends on the Boost version: use its bytes
+		boost::uuids::detail::sha1::digest_type digest;
+		sha1.get_digest(digest);
+
+		static const char HEX[] = "0123456789abcdef";
+		const unsigned char* p = reinterpret_cast<const unsigned char*>(&digest);
+
+		std::string key;
+		for (size_t i = 0; i < sizeof(digest); i++)
+		{
+			key += HEX[p[i] >> 4];
+			key += HEX[p[i] & 0xF];
+		}
+
+		return key;
+	}
+
+	static CLocation GetLocation(std::string_view metadata)
+	{
+		CLocation location;
+
+
+
+		//xml or json????
+		nlohmann::json data = nlohmann::json::parse(metadata);
+		//auto l = data.at("Location");
+		//location.m_ID = l.at("ID");
+
+		location.m_ID = data["Location"]["ID"];
+		location.m_name = data["Location"]["Name"];
+		location.m_lat = data["Location"]["Latitude"];
+		location.m_lon = data["Location"]["Longitude"];
+		location.m_elev = data["Location"]["Elevation"];
+
+		//pugi::xml_document doc;
+		//doc.load_string(metadata.c_str());
+		//pugi::xml_node node = doc.root().child("Metadata").child(CLocationVector::XML_FLAG);
+		//location.read_xml(node);
+
+		return location;
+	}
+
+	//******************************************************************************************************************************
+	//Binary columnar weather format (Format=binary):
+	//	"BSWB" magic, uint32 version, uint32 header size, JSON header: Location, TM, Begin [year, month, day, hour],
+	//	NbSteps, Variables and Replications, then for each replication and each variable, one float32 column 
+	//	of all time steps. Numbers are written in the native byte order (little-endian on all supported platforms). 
+	//	Missing values are -999.
+	static const char BINARY_MAGIC[4] = { 'B', 'S', 'W', 'B' };
+	static const uint32_t BINARY_VERSION = 1;
+
+	static bool IsBinaryWeather(std::string_view data)
+	{
+		return data.size() >= sizeof(BINARY_MAGIC) && data.compare(0, sizeof(BINARY_MAGIC), std::string_view(BINARY_MAGIC, sizeof(BINARY_MAGIC))) == 0;
+	}
+
+	static void WriteBinary(std::string& data, uint32_t value)
+	{
+		data.append((const char*)&value, sizeof(value));
+	}
+
+	static std::string GetBinaryHeader(const CLocation& location, const CWeatherYears& weather, size_t nb_replications)
+	{
+		CTPeriod p = weather.GetEntireTPeriod();
+		CTRef begin = p.Begin();
+		CWVariables variables = weather.GetVariables();
+
+		nlohmann::json var_names = nlohmann::json::array();
+		for (size_t v = 0; v < variables.size(); v++)
+			if (variables[v])
+				var_names.push_back(GetVariableName(v));
+
+		nlohmann::json header =
+		{
+			{"Location", GetLocationJSON(location)},
+			{"TM", weather.IsHourly() ? "Hourly" : "Daily"},
+			{"Begin", {begin.GetYear(), begin.GetMonth() + 1, begin.GetDay() + 1, weather.IsHourly() ? begin.GetHour() : 0}},
+			{"NbSteps", p.GetNbRef()},
+			{"Variables", var_names},
+			{"Replications", nb_replications}
+		};
+
+		std::string str_header = header.dump();
+
+		std::string data(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+		WriteBinary(data, BINARY_VERSION);
+		WriteBinary(data, uint32_t(str_header.size()));
+		data += str_header;
+
+		return data;
+	}
+
+	static std::string GetBinaryColumns(const CWeatherYears& weather)
+	{
+		CTPeriod p = weather.GetEntireTPeriod();
+		CWVariables variables = weather.GetVariables();
+		size_t nb_steps = p.GetNbRef();
+
+		std::string data;
+		data.reserve(variables.count() * nb_steps * sizeof(float));
+
+		vector<float> column(nb_steps);
+		for (size_t v = 0; v < variables.size(); v++)
+		{
+			if (variables[v])
+			{
+				for (size_t t = 0; t < nb_steps; t++)
+				{
+					//generated data have one value by time step
+					CStatistic stat = weather[p.Begin() + int(t)][TVarH(v)];
+					column[t] = stat.IsInit() ? float(stat[CStatistic::MEAN]) : -999.0f;
+				}
+
+				data.append((const char*)column.data(), column.size() * sizeof(float));
+			}
+		}
+
+		return data;
+	}
+
+	//read a binary weather. All sizes are validated against the data size before allocation
+	//and the header is parsed without exceptions: invalid data only return an error.
+	static ERMsg LoadBinaryWeather(std::string_view data, CSimulationPointVector& simulationPoints)
+	{
+		ERMsg msg;
+
+		const size_t prefix_size = sizeof(BINARY_MAGIC) + 2 * sizeof(uint32_t);
+		uint32_t version = 0;
+		uint32_t header_size = 0;
+		if (data.size() >= prefix_size)
+		{
+			memcpy(&version, data.data() + sizeof(BINARY_MAGIC), sizeof(version));
+			memcpy(&header_size, data.data() + sizeof(BINARY_MAGIC) + sizeof(version), sizeof(header_size));
+		}
+
+		if (data.size() < prefix_size || data.compare(0, sizeof(BINARY_MAGIC), std::string_view(BINARY_MAGIC, sizeof(BINARY_MAGIC))) != 0 || version != BINARY_VERSION || header_size > data.size() - prefix_size)
+		{
+			msg.ajoute("Invalid binary weather data");
+			return msg;
+		}
+
+		nlohmann::json header = nlohmann::json::parse(data.substr(prefix_size, header_size), nullptr, false);
+
+		const nlohmann::json* pLoc = (header.is_object() && header.contains("Location")) ? &header["Location"] : nullptr;
+		bool bValid = pLoc && pLoc->is_object() &&
+			pLoc->contains("ID") && (*pLoc)["ID"].is_string() && pLoc->contains("Name") && (*pLoc)["Name"].is_string() &&
+			pLoc->contains("Latitude") && (*pLoc)["Latitude"].is_number() && pLoc->contains("Longitude") && (*pLoc)["Longitude"].is_number() &&
+			pLoc->contains("Elevation") && (*pLoc)["Elevation"].is_number() &&
+			header.contains("TM") && header["TM"].is_string() &&
+			header.contains("Begin") && header["Begin"].is_array() && header["Begin"].size() == 4 &&
+			std::all_of(header["Begin"].begin(), header["Begin"].end(), [](const auto& b) { return b.is_number_unsigned(); }) &&
+			header.contains("NbSteps") && header["NbSteps"].is_number_unsigned() &&
+			header.contains("Replications") && header["Replications"].is_number_unsigned() &&
+			header.contains("Variables") && header["Variables"].is_array() && !header["Variables"].empty() &&
+			std::all_of(header["Variables"].begin(), header["Variables"].end(), [](const auto& v) { return v.is_string(); });
+
+		if (!bValid)
+		{
+			msg.ajoute("Invalid binary weather header");
+			return msg;
+		}
+
+		CLocation location;
+		location.m_ID = (*pLoc)["ID"].get<std::string>();
+		location.m_name = (*pLoc)["Name"].get<std::string>();
+		location.m_lat = (*pLoc)["Latitude"].get<double>();
+		location.m_lon = (*pLoc)["Longitude"].get<double>();
+		location.m_elev = (*pLoc)["Elevation"].get<double>();
+
+		bool bHourly = header["TM"] == "Hourly";
+		CTM TM(bHourly ? CTM::HOURLY : CTM::DAILY);
+		std::array<size_t, 4> b = header["Begin"].get<std::array<size_t, 4>>();
+		size_t nb_steps = header["NbSteps"].get<size_t>();
+		size_t nb_replications = header["Replications"].get<size_t>();
+
+		if (b[0] < 1 || b[0] > 9999 || b[1] < 1 || b[1] > 12 || b[2] < 1 || b[2] > GetNbDayPerMonth(int(b[0]), b[1] - 1) || b[3] > 23 || nb_steps == 0 || nb_steps > 10000 * 366 * 24)
+		{
+			msg.ajoute("Invalid period in binary weather header");
+			return msg;
+		}
+
+		if (nb_replications == 0)
+		{
+			msg.ajoute("Invalid number of replications in binary weather header");
+			return msg;
+		}
+
+		vector<TVarH> variables;
+		for (const auto& name : header["Variables"])
+		{
+			TVarH v = GetVariableFromName(name.get<std::string>());
+			if (v == H_SKIP)
+			{
+				msg.ajoute("Invalid variable in binary weather data: " + name.get<std::string>());
+				return msg;
+			}
+
+			variables.push_back(v);
+		}
+
+		//columns must fill exactly the rest of the data
+		std::string_view columns = data.substr(prefix_size + header_size);
+		size_t column_size = nb_steps * sizeof(float);
+		if (columns.size() % column_size != 0 || columns.size() / column_size % variables.size() != 0 || columns.size() / column_size / variables.size() != nb_replications)
+		{
+			msg.ajoute("Invalid size of binary weather data");
+			return msg;
+		}
+
+		CTRef begin(int(b[0]), b[1] - 1, b[2] - 1, b[3], TM);
+		int last_year = (begin + int(nb_steps - 1)).GetYear();
+
+		simulationPoints.resize(nb_replications);
+		vector<float> column(nb_steps);
+		for (size_t i = 0; i < nb_replications; i++)
+		{
+			((CLocation&)simulationPoints[i]) = location;
+			simulationPoints[i].m_ID = to_string(i + 1);
+			simulationPoints[i].m_name = "Replication" + to_string(i + 1);
+			simulationPoints[i].SetHourly(bHourly);
+			simulationPoints[i].CreateYears(begin.GetYear(), last_year - begin.GetYear() + 1);
+
+			for (size_t v = 0; v < variables.size(); v++)
+			{
+				memcpy(column.data(), columns.data() + (i * variables.size() + v) * column_size, column_size);
+
+				for (size_t t = 0; t < nb_steps; t++)
+					if (column[t] > -999)
+						simulationPoints[i][begin + int(t)].SetStat(variables[v], CStatistic(column[t]));
+			}
+		}
+
+		return msg;
+	}
+
+
+	//******************************************************************************************************************************
+	//
+	const char* CGlobalDLLData::NAME[NB_PAPAMS] = { "ModelsPath", "Shore", "DEM", "DailyCacheSize", "NbCPU", "PreloadModels" };
+
+	static ERMsg PreloadModels(const std::string& model_path);
+
+
+
+	void CGlobalDLLData::clear()
+	{
+		m_model_path.clear();
+		m_shore_file_path.clear();
+		m_DEM_file_path.clear();
+		m_daily_cache_size = 200;
+		m_nb_CPU = 0;
+		m_preload_models = false;
+	}
+
+
+	ERMsg CGlobalDLLData::parse(const std::string& str_init)
+	{
+		ERMsg msg;
+
+		clear();
+
+		vector<string> args = Tokenize(str_init, "&");
+		for (size_t i = 0; i < args.size(); i++)
+		{
+			string::size_type pos = args[i].find('=');
+			if (pos != string::npos)
+			{
+				string key = args[i].substr(0, pos);
+				string value = args[i].substr(pos + 1);
+
+				//auto it = std::find(begin(NAME), end(NAME), MakeUpper(option[0]));
+				//string str1 = option[0];
+				auto it = std::find_if(begin(NAME), end(NAME), [&str1 = key](const auto& str2) { return boost::iequals(str1, str2); });
+				if (it != end(NAME))
+				{
+					size_t o = distance(begin(NAME), it);
+					switch (o)
+					{
+					case MODELS_PATH: m_model_path = value; break;
+					case SHORE: m_shore_file_path = value; break;
+					case DEM: m_DEM_file_path = value; break;
+					case DAILY_CACHE_SIZE: m_daily_cache_size = std::atoi(value.c_str()); break;
+					case NB_CPU: m_nb_CPU = std::atoi(value.c_str()); break;
+					case PRELOAD_MODELS: m_preload_models = ToBool(value); break;
+					default: assert(false);
+					}
+				}
+				else
+				{
+					msg.ajoute("Invalid options in argument " + to_string(i + 1) + "( " + args[i] + ")");
+				}
+			}
+			else
+			{
+				msg.ajoute("error in argument " + to_string(i + 1) + "( " + args[i] + ")");
+			}
+		}
+
+		return msg;
+	};
+
+	std::string CBioSIM_API_GlobalData::InitGlobalData(const std::string& str_init)
+	{
+		ERMsg msg;
+
+		GDALAllRegister();
+
+		if (pGLOBAL_DLL_DATA.get() == nullptr)
+			pGLOBAL_DLL_DATA.reset(new CGlobalDLLData);
+
+		msg = pGLOBAL_DLL_DATA->parse(str_init);
+
+		if (msg)
+		{
+			try
+			{
+				CCallback callback;
+
+				if (!pGLOBAL_DLL_DATA->m_model_path.empty())
+				{
+					if (!WBSF::IsPathEndOk(pGLOBAL_DLL_DATA->m_model_path))
+						pGLOBAL_DLL_DATA->m_model_path += "/";
+				}
+
+
+				msg += CShore::SetShore(pGLOBAL_DLL_DATA->m_shore_file_path);
+
+
+				if (!pGLOBAL_DLL_DATA->m_DEM_file_path.empty())
+				{
+					pGLOBAL_DLL_DATA->m_pDEM.reset(new CGDALDatasetEx);
+					msg += pGLOBAL_DLL_DATA->m_pDEM->OpenInputImage(pGLOBAL_DLL_DATA->m_DEM_file_path);
+				}
+
+				if (pGLOBAL_DLL_DATA->m_preload_models && !pGLOBAL_DLL_DATA->m_model_path.empty())
+					msg += PreloadModels(pGLOBAL_DLL_DATA->m_model_path);
+
+
+			}
+			catch (...)
+			{
+				int i;
+				i = 0;
+			}
+		}
+
+		return get_string(msg);
+	}
+
+
+
+
+
+	//******************************************************************************************************************************
+
+	//"DefaultEndpointsProtocol","EndpointSuffix",
+	const char* CWeatherGeneratorInit::NAME[NB_PAPAMS] = { "Normals", "Daily", "Hourly", "GRIBS", "CacheSize", "NbCPU" };
+
+	CWeatherGeneratorInit::CWeatherGeneratorInit()
+	{
+		clear();
+	}
+
+	void CWeatherGeneratorInit::clear()
+	{
+		m_normal_name.clear();
+		m_daily_name.clear();
+		m_cache_size = 0;
+		m_nb_CPU = GLOBAL_NB_CPU;
+	}
+
+	ERMsg CWeatherGeneratorInit::parse(const std::string& str_init)
+	{
+		ERMsg msg;
+
+		clear();
+
+		vector<string> args = Tokenize(str_init, "&");
+		for (size_t i = 0; i < args.size(); i++)
+		{
+			string::size_type pos = args[i].find('=');
+			if (pos != string::npos)
+			{
+				string key = args[i].substr(0, pos);
+				string value = args[i].substr(pos + 1);
+
+				//auto it = std::find(begin(NAME), end(NAME), MakeUpper(option[0]));
+				//string str1 = option[0];
+				auto it = std::find_if(begin(NAME), end(NAME), [&str1 = key](const auto& str2) { return boost::iequals(str1, str2); });
+				if (it != end(NAME))
+				{
+					size_t o = distance(begin(NAME), it);
 					switch (o)
 					{
-					case VARIABLES:				m_variables = option[1]; m_variables = ReplaceString(m_variables, "+", " ");  break;
-					case SOURCE_TYPE:
+					case NORMALS: m_normal_name = value; break;
+					case DAILY: m_daily_name = value; break;
+					case CACHE_SIZE: m_cache_size = ToSizeT(value); break;
+					case NB_CPU: m_nb_CPU = std::atoi(value.c_str()); break;
+					default: assert(false);
+					}
+				}
+				else
+				{
+					msg.ajoute("Invalid options in argument " + to_string(i + 1) + "( " + args[i] + ")");
+				}
+			}
+			else
+			{
+				msg.ajoute("error in argument " + to_string(i + 1) + "( " + args[i] + ")");
+			}
+		}
+
+		return msg;
+	};
+
+
+	//******************************************************************************************************************************
+
+
+	const char* CWeatherGeneratorOptions::PARAM_NAME[NB_PAPAMS] =
+	{
+		"VARIABLES", "SOURCE", "GENERATION", "REPLICATIONS",
+		"ID", "NAME", "LATITUDE", "LONGITUDE", "ELEVATION", "SLOPE", "ORIENTATION",
+		"NB_NEAREST_NEIGHBOR", "FIRST_YEAR", "LAST_YEAR","NB_YEARS",
+		"SEED", "NORMALS_INFO", "COMPRESS", "FORMAT"
+	};
+
+	CWeatherGeneratorOptions::CWeatherGeneratorOptions()
+	{
+		m_sourceType = 1;
+		m_generationType = 1;
+		m_variables = "TN+T+TX+P";
+		m_normals_info = "1991-2020";
+		m_latitude = -999;
+		m_longitude = -999;
+		m_elevation = -999;
+		m_slope = -999;
+		m_orientation = -999;
+		m_nb_nearest_neighbor = 4;
+		m_replications = 1;
+		m_nb_years = 1;
+		m_first_year = CTRef::GetCurrentTRef().GetYear();
+		m_last_year = CTRef::GetCurrentTRef().GetYear();
+		m_seed = 0;
+		m_compress = true;
+		m_format = 0;
+	}
+
+	ERMsg CWeatherGeneratorOptions::parse(const string& str_options)
+	{
+		ERMsg msg;
+
+		vector<string> args = Tokenize(str_options, "&");
+		for (size_t i = 0; i < args.size(); i++)
+		{
+			vector<string> option = Tokenize(args[i], "=");
+			if (option.size() == 2)
+			{
+				//auto it = std::find(begin(PARAM_NAME), end(PARAM_NAME), MakeUpper(option[0]));
+				auto it = std::find_if(begin(PARAM_NAME), end(PARAM_NAME), [&str1 = option[0]](const auto& str2) { return boost::iequals(str1, str2); });
+				if (it != end(PARAM_NAME))
+				{
+					size_t o = distance(begin(PARAM_NAME), it);
+					switch (o)
+					{
+					case VARIABLES:				m_variables = option[1]; m_variables = ReplaceString(m_variables, "+", " ");  break;
+					case SOURCE_TYPE:
+					{
+						if (IsEqual(option[1], "FromNormals"))
+							m_sourceType = 0;
+						else if (IsEqual(option[1], "FromObservation"))
+							m_sourceType = 1;
+						else
+							msg.ajoute(option[1] + " is not a valid source type. Select FromNormals or FromObservation.");
+						break;
+					}
+					case NORMALS_INFO:			m_normals_info = option[1]; break;
+					case GENERATION_TYPE:
+					{
+						if (IsEqual(option[1], "Hourly"))
+							m_generationType = 0;
+						else if (IsEqual(option[1], "Daily"))
+							m_generationType = 1;
+						else
+							msg.ajoute(option[1] + " is not a valid generation type. Select Daily or Hourly.");
+
+						break;
+					}
+					case KEY_ID: m_ID = option[1]; break;
+					case NAME:m_name = option[1]; break;
+					case LATITUDE:
+					{
+						m_latitude = ToDouble(option[1]);
+						if (m_latitude < -90 || m_latitude>90)
+							msg.ajoute(option[1] + " is not a valid latitude. Latitude must between -90 and 90.");
+						break;
+					}
+					case LONGITUDE:
+					{
+						m_longitude = ToDouble(option[1]);
+						if (m_longitude < -180 || m_longitude >180)
+							msg.ajoute(option[1] + " is not a valid longitude. Longitude must between -180 and 180.");
+						break;
+					}
+					case ELEVATION:
+					{
+						m_elevation = ToDouble(option[1]);
+						if (m_elevation < -100 || m_elevation >8000)
+							msg.ajoute(option[1] + " is not a valid elevation. Elevation can by missing or between -100 and 8000 meters.");
+						break;
+					}
+					case SLOPE:					m_slope = ToDouble(option[1]); break;
+					case ORIENTATION:			m_orientation = ToDouble(option[1]); break;
+					case NB_NEAREST_NEIGHBOR:
+					{
+						m_nb_nearest_neighbor = ToSizeT(option[1]);
+						if (m_nb_nearest_neighbor == 0)
+							msg.ajoute(option[1] + " is not a valid nearest neighbor. nearest neighbor.");
+
+						break;
+					}
+					case FIRST_YEAR:
+					{
+						m_first_year = ToInt(option[1]);
+						if (m_first_year < 1900 || m_first_year>GetCurrentYear())
+							msg.ajoute(option[1] + " is not a valid year. First year must between 1900 and current year.");
+
+						break;
+					}
+					case LAST_YEAR:
+					{
+						m_last_year = ToInt(option[1]);
+						if (m_last_year < 1900 || m_last_year>GetCurrentYear())
+							msg.ajoute(option[1] + " is not a valid year. Last year must between 1900 and current year.");
+
+						break;
+					}
+					case NB_YEARS:			m_nb_years = ToInt(option[1]); break;
+					case SEED:				   m_seed = ToInt(option[1]); break;
+					case COMPRESS:			m_compress = ToBool(option[1]); break;
+					case REPLICATIONS:		   m_replications = ToInt(option[1]); break;
+					case FORMAT:
+					{
+						if (IsEqual(option[1], "CSV"))
+							m_format = 0;
+						else if (IsEqual(option[1], "Binary"))
+							m_format = 1;
+						else
+							msg.ajoute(option[1] + " is not a valid format. Select CSV or Binary.");
+
+						break;
+					}
+					default: assert(false);
+					}
+				}
+				else
+				{
+					msg.ajoute("Invalid options in argument " + to_string(i + 1) + "( " + args[i] + ")");
+				}
+			}
+			else
+			{
+				msg.ajoute("error in argument " + to_string(i + 1) + "( " + args[i] + ")");
+			}
+		}
+
+		if (m_first_year > m_last_year)
+			msg.ajoute("Last year (" + to_string(m_last_year) + ") must be greater or equal to first year (" + to_string(m_first_year) + ") .");
+
+
+		return msg;
+	}
+
+	//Load WGInput
+	void CWeatherGeneratorOptions::GetWGInput(CWGInput& WGInput)const
+	{
+		//Load WGInput
+		//CWGInput WGInput;
+
+
+		WGInput.m_variables = m_variables;
+		WGInput.m_sourceType = m_sourceType;
+		WGInput.m_generationType = m_generationType;
+		WGInput.m_nbNormalsYears = m_nb_years;
+		WGInput.m_firstYear = m_first_year;
+		WGInput.m_lastYear = m_last_year;
+		WGInput.m_bUseForecast = true;
+		WGInput.m_bUseGribs = false;
+
+		WGInput.m_nbNormalsStations = m_nb_nearest_neighbor;
+		WGInput.m_nbDailyStations = m_nb_nearest_neighbor;
+		WGInput.m_nbHourlyStations = m_nb_nearest_neighbor;
+		WGInput.m_nbGribPoints = m_nb_nearest_neighbor;
+		//WGInput.m_albedo;
+		WGInput.m_seed = m_seed;
+		WGInput.m_bXValidation = false;
+		WGInput.m_bSkipVerify = true;
+		WGInput.m_bNoFillMissing = false;
+		WGInput.m_bUseShore = true;
+		//CWVariables m_allowedDerivedVariables;
+		//CSearchRadius m_searchRadius;
+
+		//return WGInput;
+	}
+
+	//shortest string that give back the same double: to_string keep only 6 decimals
+	static std::string to_canonical(double value)
+	{
+		char buffer[32];
+		auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+		return std::string(buffer, result.ptr);
+	}
+
+	//canonical form of the options: same request give the same string whatever the order and case of the options
+	std::string CWeatherGeneratorOptions::GetCanonical()const
+	{
+		CWVariables variables;
+		variables = m_variables;
+
+		string str;
+		str += "VARIABLES=" + variables.to_string();
+		str += "&SOURCE=" + to_string(m_sourceType);
+		str += "&GENERATION=" + to_string(m_generationType);
+		str += "&REPLICATIONS=" + to_string(m_replications);
+		str += "&ID=" + m_ID;
+		str += "&NAME=" + m_name;
+		str += "&LATITUDE=" + to_canonical(m_latitude);
+		str += "&LONGITUDE=" + to_canonical(m_longitude);
+		str += "&ELEVATION=" + to_canonical(m_elevation);
+		str += "&SLOPE=" + to_canonical(m_slope);
+		str += "&ORIENTATION=" + to_canonical(m_orientation);
+		str += "&NB_NEAREST_NEIGHBOR=" + to_string(m_nb_nearest_neighbor);
+		str += "&FIRST_YEAR=" + to_string(m_first_year);
+		str += "&LAST_YEAR=" + to_string(m_last_year);
+		str += "&NB_YEARS=" + to_string(m_nb_years);
+		str += "&SEED=" + to_string(m_seed);
+		str += "&NORMALS_INFO=" + m_normals_info;
+		str += "&COMPRESS=" + to_string(m_compress);
+		str += "&FORMAT=" + to_string(m_format);
+
+		return str;
+	}
+
+
+	//******************************************************************************************************************************
+
+	//CCriticalSection m_CS;//to protect shore
+	std::mutex m_mutex;//to protect shore
+	std::mutex m_DEM_mutex;//to protect DEM: GDAL dataset is not thread safe
+
+
+	//Databases loaded by all instances of the process. A database is shared
+	//as long as one instance use it and is released with the last one.
+	template <class T>
+	class CDatabaseRegistry
+	{
+	public:
+
+		typedef std::shared_ptr<T> TPtr;
+
+		//the lock is released while loading: only calls for the same database wait for the load
+		ERMsg get(const std::string& key, std::function<ERMsg(TPtr&)> load, TPtr& pDB)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			//remove released databases
+			for (auto it = m_databases.begin(); it != m_databases.end();)
+				it = it->second.expired() ? m_databases.erase(it) : std::next(it);
+
+			auto it = m_databases.find(key);
+			pDB = it != m_databases.end() ? it->second.lock() : TPtr();
+			if (pDB)
+				return ERMsg();
+
+			//same database in loading: wait for its result
+			auto it_loading = m_loading.find(key);
+			if (it_loading != m_loading.end())
+			{
+				CLoadResult result = it_loading->second;
+				lock.unlock();
+
+				pDB = result.get().second;
+				return result.get().first;
+			}
+
+			std::promise<std::pair<ERMsg, TPtr>> promise;
+			m_loading[key] = promise.get_future().share();
+			lock.unlock();
+
+			ERMsg msg;
+			try
+			{
+				msg = load(pDB);
+			}
+			catch (...)
+			{
+				msg.ajoute("Unexpected error loading database " + key);
+			}
+
+			if (!msg)
+				pDB.reset();
+
+			lock.lock();
+			if (msg)
+				m_databases[key] = pDB;
+			m_loading.erase(key);
+			lock.unlock();
+
+			promise.set_value(make_pair(msg, pDB));
+
+			return msg;
+		}
+
+		size_t size()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return std::count_if(m_databases.begin(), m_databases.end(), [](const auto& p) { return !p.second.expired(); });
+		}
+
+	protected:
+
+		typedef std::shared_future<std::pair<ERMsg, TPtr>> CLoadResult;
+
+		std::mutex m_mutex;
+		std::map<std::string, std::weak_ptr<T>> m_databases;
+		std::map<std::string, CLoadResult> m_loading;
+	};
+
+	static CDatabaseRegistry<CNormalsDatabase> NORMALS_REGISTRY;
+	static CDatabaseRegistry<CDailyDatabase> DAILY_REGISTRY;
+
+	//database identity: canonical path, size and last modification time
+	static std::string GetDatabaseKey(const std::string& file_path)
+	{
+		std::error_code ec;
+		std::filesystem::path path = std::filesystem::canonical(file_path, ec);
+		if (ec)
+			return file_path;
+
+		std::string key = path.string();
+		key += "|" + to_string(std::filesystem::file_size(path, ec));
+		key += "|" + to_string(std::filesystem::last_write_time(path, ec).time_since_epoch().count());
+
+		return key;
+	}
+
+	static ERMsg OpenNormalsDatabase(const std::string& file_path, CNormalsDatabasePtr& pNormalDB)
+	{
+		return NORMALS_REGISTRY.get(GetDatabaseKey(file_path), [&file_path](CNormalsDatabasePtr& pDB)
+			{
+				ERMsg msg;
+				CCallback callback;
+
+				pDB.reset(new CNormalsDatabase);
+
+				if (IsEqual(GetFileExtension(file_path), ".NormalsDB"))
+				{
+					msg += pDB->Open(file_path);
+
+					if (msg)
+						pDB->OpenSearchOptimization(callback);
+				}
+				else if (IsEqual(GetFileExtension(file_path), ".gz"))
+				{
+					msg += pDB->LoadFromBinary(file_path);
+					if (msg)
+						pDB->CreateAllCanals();
+				}
+				else
+				{
+					msg.ajoute("Invalid Normals database extension: " + file_path);
+				}
+
+				return msg;
+			}, pNormalDB);
+	}
+
+	//Daily databases read from disk (.DailyDB) load stations on demand in a cache that is not protected 
+	//against concurrent access: they are never shared. Each generator in use take its own instance 
+	//from the pool and give it back when released. Instances stay open for the next calls.
+	class CDailyDatabasePool : public std::enable_shared_from_this<CDailyDatabasePool>
+	{
+	public:
+
+		CDailyDatabasePool(const std::string& file_path, size_t cache_size) :
+			m_file_path(file_path),
+			m_cache_size(cache_size)
+		{
+		}
+
+		ERMsg get(CDailyDatabasePtr& pDailyDB)
+		{
+			ERMsg msg;
+
+			CDailyDatabasePtr pDB;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (!m_free.empty())
+				{
+					pDB = m_free.back();
+					m_free.pop_back();
+				}
+			}
+
+			//open outside the lock: instances can be opened in parallel
+			if (!pDB)
+			{
+				CCallback callback;
+				pDB = make_shared<CDailyDatabase>(int(m_cache_size));
+				msg += pDB->Open(m_file_path, CDailyDatabase::modeRead, callback, true);
+				if (msg)
+					msg += pDB->OpenSearchOptimization(callback);
+			}
+
+			if (msg)
+			{
+				//given back to the pool when the generator release it
+				std::shared_ptr<CDailyDatabasePool> pPool = shared_from_this();
+				pDailyDB = CDailyDatabasePtr(pDB.get(), [pPool, pDB](CDailyDatabase*) { pPool->release(pDB); });
+			}
+
+			return msg;
+		}
+
+	protected:
+
+		void release(const CDailyDatabasePtr& pDB)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_free.push_back(pDB);
+		}
+
+		std::string m_file_path;
+		size_t m_cache_size;
+		std::mutex m_mutex;
+		std::vector<CDailyDatabasePtr> m_free;
+	};
+
+	//Databases loaded in memory (.gz) are complete once loaded: shared read-only by all generators of all instances.
+	//Databases read from disk (.DailyDB) are opened in a pool of the instance: one opened database per generator in use.
+	static ERMsg OpenDailyDatabase(const std::string& file_path, CDailyDatabasePtr& pDailyDB, CDailyDatabasePoolPtr& pDailyDBPool)
+	{
+		ERMsg msg;
+
+		size_t cache_size = pGLOBAL_DLL_DATA->m_daily_cache_size;
+
+		pDailyDB.reset();
+		pDailyDBPool.reset();
+
+		if (IsEqual(GetFileExtension(file_path), ".DailyDB"))
+		{
+			//open a first instance to validate the database, kept open in the pool
+			CDailyDatabasePoolPtr pPool = make_shared<CDailyDatabasePool>(file_path, cache_size);
+			CDailyDatabasePtr pDB;
+			msg += pPool->get(pDB);
+			if (msg)
+				pDailyDBPool = pPool;
+		}
+		else if (IsEqual(GetFileExtension(file_path), ".gz"))
+		{
+			msg += DAILY_REGISTRY.get(GetDatabaseKey(file_path) + "|" + to_string(cache_size), [&file_path, cache_size](CDailyDatabasePtr& pDB)
+				{
+					ERMsg msg;
+
+					pDB.reset(new CDailyDatabase(int(cache_size)));
+					msg += pDB->LoadFromBinary(file_path);
+					if (msg)
+						pDB->CreateAllCanals();
+
+					return msg;
+				}, pDailyDB);
+		}
+		else
+		{
+			msg.ajoute("Invalid Daily database extension: " + file_path);
+		}
+
+		return msg;
+	}
+
+	//Models loaded by all instances of the process. Models are kept loaded until the end of the process.
+	//Each model comes with a mutex shared by all instances: runs of a model that is not declared 
+	//thread-safe are serialized, whatever the instance that calls it.
+	class CModelRegistry
+	{
+	public:
+
+		typedef std::shared_ptr<std::mutex> CMutexPtr;
+
+		ERMsg get(const std::string& file_path, CModelPtr& pModel)
+		{
+			CMutexPtr pMutex;
+			return get(file_path, pModel, pMutex);
+		}
+
+		ERMsg get(const std::string& file_path, CModelPtr& pModel, CMutexPtr& pMutex)
+		{
+			ERMsg msg;
+
+			std::string key = GetDatabaseKey(file_path);
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				auto it = m_models.find(key);
+				if (it != m_models.end())
+				{
+					pModel = it->second.first;
+					pMutex = it->second.second;
+					return msg;
+				}
+			}
+
+			//load outside the lock: models can be loaded in parallel
+			CModelPtr pNewModel = make_shared<CModel>();
+			msg += pNewModel->Load(file_path);
+			if (msg)
+				msg += pNewModel->LoadLibrary();
+
+			if (msg)
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				auto it = m_models.emplace(key, make_pair(pNewModel, make_shared<std::mutex>())).first;
+				pModel = it->second.first;
+				pMutex = it->second.second;
+			}
+
+			return msg;
+		}
+
+		size_t size()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_models.size();
+		}
+
+	protected:
+
+		std::mutex m_mutex;
+		std::map<std::string, std::pair<CModelPtr, CMutexPtr>> m_models;
+	};
+
+	static CModelRegistry MODEL_REGISTRY;
+
+	//load all models of the directory in parallel
+	static ERMsg PreloadModels(const std::string& model_path)
+	{
+		ERMsg msg;
+
+		vector<string> file_paths;
+		std::error_code ec;
+		for (const auto& entry : std::filesystem::directory_iterator(model_path, ec))
+		{
+			if (entry.is_regular_file() && IsEqualNoCase(entry.path().extension().string(), ".mdl"))
+				file_paths.push_back(entry.path().string());
+		}
+
+		if (ec)
+		{
+			msg.ajoute("Unable to read models directory " + model_path + ": " + ec.message());
+			return msg;
+		}
+
+		vector<ERMsg> messages(file_paths.size());
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(GetNbCPU())
+		for (int i = 0; i < (int)file_paths.size(); i++)
+		{
+			try
+			{
+				CModelPtr pModel;
+				messages[i] = MODEL_REGISTRY.get(file_paths[i], pModel);
+			}
+			catch (...)
+			{
+				messages[i].ajoute("Unexpected error loading model " + file_paths[i]);
+			}
+		}
+
+		for (size_t i = 0; i < messages.size(); i++)
+			msg += messages[i];
+
+		return msg;
+	}
+
+
+
+	CWeatherGeneratorAPI::CWeatherGeneratorAPI(const std::string&)
+	{
+		m_pSingleFlight = make_shared<CSingleFlight>();
+	}
+
+	//create a new weather generator for one call. Databases in memory are shared read-only between all generators,
+	//databases read from disk are taken from the pool: one per generator
+	ERMsg CWeatherGeneratorAPI::CreateWeatherGenerator(CWeatherGeneratorPtr& pWG)const
+	{
+		assert(m_pNormalDB);
+
+		ERMsg msg;
+
+		//the generator keep its own snapshot of the daily database until the end of the call
+		CDailyDatabasePtr pDailyDB;
+		CDailyDatabasePoolPtr pDailyDBPool;
+		{
+			std::lock_guard<std::mutex> lock(m_DB_mutex);
+			pDailyDB = m_pDailyDB;
+			pDailyDBPool = m_pDailyDBPool;
+		}
+
+		if (pDailyDBPool)
+			msg += pDailyDBPool->get(pDailyDB);
+
+		if (msg)
+		{
+			pWG = make_shared<CWeatherGenerator>();
+			pWG->SetNormalDB(m_pNormalDB);
+			pWG->SetDailyDB(pDailyDB);
+		}
+
+		return msg;
+	}
+
+	//number of threads of this instance
+	int CWeatherGeneratorAPI::GetNbCPU()const
+	{
+		return WBSF::GetNbCPU(m_init.m_nb_CPU);
+	}
+
+	//cache key: options and databases identity
+	std::string CWeatherGeneratorAPI::GetCacheKey(const CWeatherGeneratorOptions& options)const
+	{
+		std::lock_guard<std::mutex> lock(m_DB_mutex);
+		return m_DB_key + "&" + options.GetCanonical();
+	}
+
+	size_t CWeatherGeneratorAPI::GetCacheHits()const
+	{
+		return m_pCache ? m_pCache->hits() : 0;
+	}
+
+	size_t CWeatherGeneratorAPI::GetCacheMisses()const
+	{
+		return m_pCache ? m_pCache->misses() : 0;
+	}
+
+	size_t CWeatherGeneratorAPI::GetNbLoadedDatabases()
+	{
+		return NORMALS_REGISTRY.size() + DAILY_REGISTRY.size();
+	}
+
+
+
+	std::string CWeatherGeneratorAPI::Initialize(const std::string& str_init)
+	{
+		ERMsg msg;
+
+
+
+		msg = m_init.parse(str_init);
+
+		if (msg)
+		{
+			try
+			{
+
+				//databases already loaded by another instance are shared
+				if (!m_init.m_normal_name.empty())
+				{
+					msg += OpenNormalsDatabase(m_init.m_normal_name, m_pNormalDB);
+
+					if (msg && !m_init.m_daily_name.empty())
+						msg += OpenDailyDatabase(m_init.m_daily_name, m_pDailyDB, m_pDailyDBPool);
+
+					m_DB_key = "Normals=" + GetDatabaseKey(m_init.m_normal_name) + "&Daily=" + (m_init.m_daily_name.empty() ? "" : GetDatabaseKey(m_init.m_daily_name));
+				}
+
+				if (msg)
+				{
+					CStatistic::SetVMiss(-999);//set once here: not thread safe
+
+					if (m_init.m_cache_size > 0)
+						m_pCache = make_shared<CTeleIOCache>(m_init.m_cache_size * 1024 * 1024);
+					else
+						m_pCache.reset();
+				}
+				else
+				{
+					m_pNormalDB.reset();
+					m_pDailyDB.reset();
+					m_pDailyDBPool.reset();
+				}
+			}
+			catch (...)
+			{
+				int i;
+				i = 0;
+			}
+		}
+
+		return get_string(msg);
+	}
+
+
+	//Load the daily database again and swap it when ready. Calls in progress
+	//finish with the previous database. Can be called from a background thread.
+	std::string CWeatherGeneratorAPI::Reload()
+	{
+		ERMsg msg;
+
+		if (m_pNormalDB.get() == nullptr || m_init.m_daily_name.empty())
+		{
+			msg.ajoute("Daily database is not define yet. Call Initialize first");
+			return get_string(msg);
+		}
+
+		std::lock_guard<std::mutex> reload_lock(m_reload_mutex);
+
+		try
+		{
+			//unchanged file is taken from the registry without loading
+			std::string DB_key = "Normals=" + GetDatabaseKey(m_init.m_normal_name) + "&Daily=" + GetDatabaseKey(m_init.m_daily_name);
+
+			CDailyDatabasePtr pDailyDB;
+			CDailyDatabasePoolPtr pDailyDBPool;
+			msg += OpenDailyDatabase(m_init.m_daily_name, pDailyDB, pDailyDBPool);
+
+			if (msg)
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_DB_mutex);
+					m_pDailyDB.swap(pDailyDB);
+					m_pDailyDBPool.swap(pDailyDBPool);
+					m_DB_key = DB_key;
+				}
+
+				//results of the previous database are not used anymore
+				if (m_pCache && (pDailyDB != m_pDailyDB || pDailyDBPool != m_pDailyDBPool))
+					m_pCache->clear();
+			}
+		}
+		catch (std::exception& e)
+		{
+			msg.ajoute(e.what());
+		}
+
+		return get_string(msg);
+	}
+
+
+	ERMsg CWeatherGeneratorAPI::ComputeElevation(double latitude, double longitude, double& elevation)
+	{
+		ERMsg msg;
+
+		std::lock_guard<std::mutex> lock(m_DEM_mutex);
+		if (pGLOBAL_DLL_DATA->m_pDEM && pGLOBAL_DLL_DATA->m_pDEM->IsOpen())
+		{
+			CGeoPoint pt(longitude, latitude, PRJ_WGS_84);
+
+			CGeoPointIndex xy = pGLOBAL_DLL_DATA->m_pDEM->GetExtents().CoordToXYPos(pt);
+			if (pGLOBAL_DLL_DATA->m_pDEM->GetExtents().is_inside(xy))
+			{
+				elevation = pGLOBAL_DLL_DATA->m_pDEM->ReadPixel(0, xy);
+
+				if (fabs(elevation - pGLOBAL_DLL_DATA->m_pDEM->GetNoData(0)) < 0.1)
+				{
+					msg.ajoute("DEM is not available for the lat/lon coordinate.");
+				}
+			}
+			else
+			{
+				msg.ajoute("Lat/lon outside DEM extents.");
+			}
+		}
+		else
+		{
+			msg.ajoute("Elevation and DEM is not provided. Invalid elevation.");
+		}
+
+		return msg;
+	}
+
+
+	//generate weather for one location and write all replications (CSV) to the stream.
+	//From observations, one generator match stations once and generate all replications: 
+	//only the serialization is done in parallel. From normals, replications are generated in parallel, 
+	//each with its own seed derived from the location seed, by one generator per thread set to the target once.
+	//In both cases, the output is the same whatever the number of threads.
+	//Replications are written in order as soon as they are ready: memory is bounded by
+	//the window of replications in progress and not by the number of replications.
+	ERMsg CWeatherGeneratorAPI::GenerateWeather(const CWeatherGeneratorOptions& options, const CLocation& location, unsigned long seed, std::ostream& out, CCallback& callback, CPhaseTimer& timer, CSimulationPointVector* pSimulationPoints)const
+	{
+		ERMsg msg;
+
+		if (pSimulationPoints)
+			pSimulationPoints->resize(options.m_replications);
+
+		//Load WGInput
+		CWGInput WGInput;
+		options.GetWGInput(WGInput);
+
+		vector<ERMsg> messages(options.m_replications);
+		vector<string> data(options.m_replications);
+		vector<std::bitset<CWeatherGenerator::NB_WARNING>> warnings(options.m_replications);
+		CWVariablesCounter missing;
+		std::bitset<CWeatherGenerator::NB_WARNING> warning;
+
+		//from observations: station search and gradient are done once for all replications
+		CWeatherGeneratorPtr pSharedWG;
+		if (WGInput.m_sourceType == CWGInput::FROM_OBSERVATIONS || options.m_replications == 1)
+		{
+			CThreadCPUTimer gen_timer;
+
+			msg = CreateWeatherGenerator(pSharedWG);
+			if (msg)
+			{
+				pSharedWG->SetSeed(seed);
+				pSharedWG->SetNbReplications(options.m_replications);
+				pSharedWG->SetWGInput(WGInput);
+				pSharedWG->SetTarget(location);
+				msg = pSharedWG->Generate();
+			}
+
+			if (msg)
+			{
+				warning = pSharedWG->GetWarningBits();
+				missing = pSharedWG->GetMissingCount();
+			}
+
+			timer.add("Generation", gen_timer.elapsed());
+		}
+
+		//from normals: first replication use the location seed, the others are derived from it
+		CRandomGenerator rand(seed);
+		vector<unsigned long> seeds(options.m_replications);
+		for (size_t r = 0; r < seeds.size(); r++)
+			seeds[r] = (r == 0) ? seed : 1 + rand.Rand();
+
+		//one generator per thread, created on first use
+		vector<CWeatherGeneratorPtr> WGs(GetNbCPU());
+
+		//replications are written in order as soon as they are ready, without waiting for the others.
+		//A replication is not started more than "window" replications ahead of the next one to write.
+		const size_t window = 2 * size_t(GetNbCPU());
+		size_t next = 0;
+		std::mutex write_mutex;
+		std::condition_variable written;
+		vector<bool> ready(options.m_replications, false);
+		std::atomic<bool> failed(!msg);
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(GetNbCPU()) if (options.m_replications > 1)
+		for (int r = 0; r < int(options.m_replications); r++)
+		{
+			{
+				//replications are given in order: the one to write is already running on another thread
+				std::unique_lock<std::mutex> lock(write_mutex);
+				written.wait(lock, [&] { return size_t(r) < next + window || failed; });
+			}
+
+			if (failed)
+				continue;
+
+			try
+			{
+				CThreadCPUTimer rep_timer;
+
+				const CSimulationPoint* pWeather = nullptr;
+				if (pSharedWG)
+				{
+					pWeather = &pSharedWG->GetWeather(r);
+				}
+				else
+				{
+					CWeatherGeneratorPtr& pWG = WGs[omp_get_thread_num()];
+					if (!pWG)
+					{
+						messages[r] = CreateWeatherGenerator(pWG);
+						if (messages[r])
+						{
+							pWG->SetNbReplications(1);
+							pWG->SetWGInput(WGInput);
+							pWG->SetTarget(location);
+						}
+					}
+
+					if (messages[r])
 					{
-						if (IsEqual(option[1], "FromNormals"))
-							m_sourceType = 0;
-						else if (IsEqual(option[1], "FromObservation"))
-							m_sourceType = 1;
-						else
-							msg.ajoute(option[1] + " is not a valid source type. Select FromNormals or FromObservation.");
-						break;
+						pWG->SetSeed(seeds[r]);
+						messages[r] = pWG->Generate();
 					}
-					case NORMALS_INFO:			m_normals_info = option[1]; break;
-					case GENERATION_TYPE:
+					timer.add("Generation", rep_timer.elapsed());
+
+					if (messages[r])
+					{
+						warnings[r] = pWG->GetWarningBits();
+						//normals stations don't depend on the seed: the same for all replications
+						if (r == 0)
+							missing = pWG->GetMissingCount();
+
+						pWeather = &pWG->GetWeather(0);
+					}
+				}
+
+				if (messages[r])
+				{
+					//write info and weather to the stream
+					rep_timer.start();
+					const CSimulationPoint& weather = *pWeather;
+					if (pSimulationPoints)
+					{
+						//keep weather in memory: same location and names as LoadWeather
+						CSimulationPoint& simulationPoint = (*pSimulationPoints)[r];
+						simulationPoint = weather;
+						((CLocation&)simulationPoint) = location;
+						simulationPoint.m_ID = to_string(r + 1);
+						simulationPoint.m_name = "Replication" + to_string(r + 1);
+					}
+					else if (options.m_format == 1)
+					{
+						//header is written once, before the first replication
+						if (r == 0)
+							data[r] = GetBinaryHeader(location, weather, options.m_replications);
+
+						data[r] += GetBinaryColumns(weather);
+					}
+					else
+					{
+						std::stringstream sender;
+						CTM TM = weather.GetTM();
+						messages[r] = ((CWeatherYears&)weather).SaveData(sender, TM, ',');
+						data[r] = sender.str();
+					}
+					timer.add("Serialization", rep_timer.elapsed());
+				}
+			}
+			catch (...)
+			{
+				messages[r].ajoute("Unexpected error for replication " + to_string(r + 1));
+			}
+
+			std::lock_guard<std::mutex> lock(write_mutex);
+			ready[r] = true;
+			for (; next < options.m_replications && ready[next] && !failed; next++)
+			{
+				msg += messages[next];
+				warning |= warnings[next];
+				if (msg)
+				{
+					out << data[next];
+					out.flush();
+				}
+				else
+				{
+					failed = true;
+				}
+
+				string().swap(data[next]);
+			}
+
+			written.notify_all();
+		}   // for replication
+
+		if (msg)
+			CWeatherGenerator::OutputWarning(warning, missing, callback);
+
+		return msg;
+	}
+
+	CTeleIO CWeatherGeneratorAPI::Generate(const std::string& str_options)
+	{
+		assert(m_pNormalDB != nullptr);
+
+		CTeleIO output;
+		if (m_pNormalDB.get() == nullptr)
+		{
+			output.m_msg = "Weather generator is not define yet. Call Initialize first";
+			return output;
+		}
+
+		CPhaseTimer timer;
+		timer.start("Parse");
+
+		CWeatherGeneratorOptions options;
+		ERMsg msg = options.parse(str_options);
+		if (!msg)
+		{
+			output.m_msg = get_string(msg);
+			output.m_comment = ANSI_UTF8("");
+			SetTiming(output, timer);
+			return output;
+		}
+
+		//random requests are always generated
+		if (options.m_seed == 0)
+			return GenerateOutput(options, timer);
+
+		//deterministic requests are cached and identical concurrent requests are generated only once
+		string key = GetCacheKey(options);
+		if (m_pCache)
+		{
+			timer.start("Cache");
+			if (m_pCache->get(key, output))
+			{
+				SetTiming(output, timer);
+				return output;
+			}
+		}
+
+		return m_pSingleFlight->Do(key, [&]()
+			{
+				CTeleIO result = GenerateOutput(options, timer);
+				if (m_pCache && result.m_msg == get_string(ERMsg()))
+					m_pCache->set(key, result);
+
+				return result;
+			});
+	}
+
+	//generate weather in memory for the model, with the same seeds as Generate
+	ERMsg CWeatherGeneratorAPI::GenerateSimulationPoints(CWeatherGeneratorOptions options, CSimulationPointVector& simulationPoints, CCallback& callback, CPhaseTimer& timer)const
+	{
+		ERMsg msg;
+
+		if (m_pNormalDB.get() == nullptr)
+		{
+			msg.ajoute("Weather generator is not define yet. Call Initialize first");
+			return msg;
+		}
+
+		try
+		{
+			timer.start("Elevation");
+			if (options.m_elevation < -100)
+				msg = ComputeElevation(options.m_latitude, options.m_longitude, options.m_elevation);
+
+			timer.stop();
+
+			if (msg)
+			{
+				CLocation location(options.m_name, options.m_ID, options.m_latitude, options.m_longitude, options.m_elevation);
+
+				CRandomGenerator rand(options.m_seed);
+				unsigned long seed = 1 + rand.Rand();
+
+				std::stringstream unused;
+				timer.start("Generation");
+				msg = GenerateWeather(options, location, seed, unused, callback, timer, &simulationPoints);
+				timer.stop();
+			}
+		}
+		catch (std::exception& e)
+		{
+			msg.ajoute(e.what());
+		}
+
+		return msg;
+	}
+
+	CTeleIO CWeatherGeneratorAPI::GenerateOutput(CWeatherGeneratorOptions options, CPhaseTimer& timer)const
+	{
+		ERMsg msg;
+		CCallback callback;
+		CTeleIO output;
+
+		try
+		{
+			timer.start("Elevation");
+			if (options.m_elevation < -100)
+				msg = ComputeElevation(options.m_latitude, options.m_longitude, options.m_elevation);
+
+			timer.stop();
+
+			if (msg)
+			{
+				CLocation location(options.m_name, options.m_ID, options.m_latitude, options.m_longitude, options.m_elevation);
+
+				//init random generator
+				CRandomGenerator rand(options.m_seed);
+				unsigned long seed = 1 + rand.Rand();
+
+				std::stringstream sender;
+				timer.start("Generation");
+				msg = GenerateWeather(options, location, seed, sender, callback, timer);
+				timer.stop();
+
+				if (msg)
+				{
+					nlohmann::json l = { {"Location", GetLocationJSON(location)} };
+					output.m_metadata = l.dump();
+
+					// Compress
+					timer.start("Compression");
+					output.m_compress = options.m_compress;
+					output.m_data = GetData(sender, options.m_compress);
+					timer.stop();
+				}
+			}
+
+		}
+		catch (...)
+		{
+			int i;
+			i = 0;
+		}
+
+		output.m_msg = get_string(msg);
+		output.m_comment = ANSI_UTF8(callback.GetMessages());
+		SetTiming(output, timer);
+
+		return output;
+	}
+
+	//Generate weather and send data to the sink by chunks (at most 1 MB, at least one per block of
+	//replications) as soon as they are available. Data is not kept: m_data of the output is empty.
+	//When compressed, the concatenation of all chunks is one gzip stream.
+	//Results are neither cached nor shared with identical requests.
+	CTeleIO CWeatherGeneratorAPI::GenerateStream(const std::string& str_options, const std::function<void(const std::string&)>& sink)
+	{
+		assert(m_pNormalDB != nullptr);
+
+		CTeleIO output;
+		if (m_pNormalDB.get() == nullptr)
+		{
+			output.m_msg = "Weather generator is not define yet. Call Initialize first";
+			return output;
+		}
+
+		ERMsg msg;
+		CCallback callback;
+		CPhaseTimer timer;
+
+		try
+		{
+			timer.start("Parse");
+			CWeatherGeneratorOptions options;
+			msg = options.parse(str_options);
+
+			if (msg)
+			{
+				timer.start("Elevation");
+				if (options.m_elevation < -100)
+					msg = ComputeElevation(options.m_latitude, options.m_longitude, options.m_elevation);
+
+				timer.stop();
+			}
+
+			if (msg)
+			{
+				CLocation location(options.m_name, options.m_ID, options.m_latitude, options.m_longitude, options.m_elevation);
+
+				//same seed as Generate: same data
+				CRandomGenerator rand(options.m_seed);
+				unsigned long seed = 1 + rand.Rand();
+
+				//each replication is flushed to the sink as soon as it is written
+				boost::iostreams::filtering_ostream out;
+				out.push(CChunkSink(sink, options.m_compress), CChunkSink::CHUNK_SIZE);
+
+				timer.start("Generation");
+				msg = GenerateWeather(options, location, seed, out, callback, timer);
+
+				//flush last chunk
+				out.reset();
+				timer.stop();
+
+				nlohmann::json l = { {"Location", GetLocationJSON(location)} };
+				output.m_metadata = l.dump();
+				output.m_compress = options.m_compress;
+			}
+		}
+		catch (std::exception& e)
+		{
+			msg.ajoute(e.what());
+		}
+
+		output.m_msg = get_string(msg);
+		output.m_comment = ANSI_UTF8(callback.GetMessages());
+		SetTiming(output, timer);
+
+		return output;
+	}
+
+	//Generate weather for a list of locations in JSON: [{"ID":"1","Name":"Logan","Latitude":41.73,"Longitude":-111.8,"Elevation":120},...]
+	//ID, Name and Elevation are optional. Other options are the same as Generate and are shared by all locations.
+	//Data of all locations are concatenated in the same order. The metadata give, for each location, 
+	//the offset and size of its data (uncompressed) and its own error message.
+	CTeleIO CWeatherGeneratorAPI::GenerateBatch(const std::string& str_options, const std::string& str_locations)
+	{
+		assert(m_pNormalDB != nullptr);
+
+		CTeleIO output;
+		if (m_pNormalDB.get() == nullptr)
+		{
+			output.m_msg = "Weather generator is not define yet. Call Initialize first";
+			return output;
+		}
+
+		ERMsg msg;
+		CCallback callback;
+		CPhaseTimer timer;
+
+		try
+		{
+			timer.start("Parse");
+			CWeatherGeneratorOptions options;
+			msg = options.parse(str_options);
+
+			CLocationVector locations;
+			if (msg)
+			{
+				nlohmann::json data = nlohmann::json::parse(str_locations, nullptr, false);
+				if (data.is_array())
+				{
+					for (size_t i = 0; i < data.size(); i++)
 					{
-						if (IsEqual(option[1], "Hourly"))
-							m_generationType = 0;
-						else if (IsEqual(option[1], "Daily"))
-							m_generationType = 1;
+						const nlohmann::json& l = data[i];
+						if (l.contains("Latitude") && l.contains("Longitude"))
+						{
+							auto get_str = [&l, i](const char* name) { return !l.contains(name) ? to_string(i + 1) : l[name].is_string() ? l[name].get<string>() : l[name].dump(); };
+
+							CLocation location;
+							location.m_ID = get_str("ID");
+							location.m_name = get_str("Name");
+							location.m_lat = l["Latitude"];
+							location.m_lon = l["Longitude"];
+							location.m_elev = l.value("Elevation", -999.0);
+							locations.push_back(location);
+						}
 						else
-							msg.ajoute(option[1] + " is not a valid generation type. Select Daily or Hourly.");
-
-						break;
+						{
+							msg.ajoute("Latitude and Longitude must be define for location " + to_string(i + 1));
+						}
 					}
-					case KEY_ID: m_ID = option[1]; break;
-					case NAME:m_name = option[1]; break;
-					case LATITUDE:
+				}
+				else
+				{
+					msg.ajoute("Invalid locations. Locations must be a JSON array.");
+				}
+			}
+
+			timer.stop();
+
+			if (msg)
+			{
+				//init each seed for each locations
+				CRandomGenerator rand(options.m_seed);
+				vector<unsigned long> seeds(locations.size());
+				for (size_t l = 0; l < locations.size(); l++)
+					seeds[l] = 1 + rand.Rand();
+
+				vector<ERMsg> messages(locations.size());
+				vector<string> data(locations.size());
+				vector<string> comments(locations.size());
+
+				timer.start("Generation");
+#pragma omp parallel for schedule(dynamic, 1) num_threads(GetNbCPU())
+				for (int l = 0; l < (int)locations.size(); l++)
+				{
+					try
 					{
-						m_latitude = ToDouble(option[1]);
-						if (m_latitude < -90 || m_latitude>90)
-							msg.ajoute(option[1] + " is not a valid latitude. Latitude must between -90 and 90.");
-						break;
+						CCallback loc_callback;
+						CLocation& location = locations[l];
+						if (location.m_elev < -100)
+						{
+							CThreadCPUTimer elev_timer;
+							messages[l] = ComputeElevation(location.m_lat, location.m_lon, location.m_elev);
+							timer.add("Elevation", elev_timer.elapsed());
+						}
+
+						if (messages[l])
+						{
+							std::stringstream sender;
+							messages[l] = GenerateWeather(options, location, seeds[l], sender, loc_callback, timer);
+							if (messages[l])
+								data[l] = sender.str();
+						}
+
+						comments[l] = loc_callback.GetMessages();
 					}
-					case LONGITUDE:
+					catch (...)
 					{
-						m_longitude = ToDouble(option[1]);
-						if (m_longitude < -180 || m_longitude >180)
-							msg.ajoute(option[1] + " is not a valid longitude. Longitude must between -180 and 180.");
-						break;
+						messages[l].ajoute("Unexpected error for location " + locations[l].m_ID);
 					}
-					case ELEVATION:
+				}
+				timer.stop();
+
+
+				nlohmann::json metadata = nlohmann::json::array();
+				std::stringstream sender;
+				size_t offset = 0;
+				for (size_t l = 0; l < locations.size(); l++)
+				{
+					nlohmann::json loc = GetLocationJSON(locations[l]);
+					loc["Msg"] = get_string(messages[l]);
+					loc["Offset"] = offset;
+					loc["Size"] = data[l].size();
+					metadata.push_back(loc);
+
+					sender << data[l];
+					offset += data[l].size();
+					msg += messages[l];
+
+					if (!comments[l].empty())
+						callback.AddMessage(locations[l].m_ID + ": " + comments[l]);
+				}
+
+				nlohmann::json l = { {"Locations", metadata} };
+				output.m_metadata = l.dump();
+
+				// Compress
+				timer.start("Compression");
+				output.m_compress = options.m_compress;
+				output.m_data = GetData(sender, options.m_compress);
+				timer.stop();
+			}
+		}
+		catch (const std::exception& e)
+		{
+			msg.ajoute(e.what());
+		}
+		catch (...)
+		{
+			int i;
+			i = 0;
+		}
+
+		output.m_msg = get_string(msg);
+		output.m_comment = ANSI_UTF8(callback.GetMessages());
+		SetTiming(output, timer);
+
+		return output;
+	}
+
+
+	CTeleIO CWeatherGeneratorAPI::GetNormals(const std::string& str_options)
+	{
+		assert(m_pNormalDB != nullptr);
+
+		CTeleIO output;
+		if (m_pNormalDB.get() == nullptr)
+		{
+			output.m_msg = "Weather generator is not define yet. Call Initialize first";
+			return output;
+		}
+
+		ERMsg msg;
+		CCallback callback;
+		CPhaseTimer timer;
+
+		try
+		{
+			timer.start("Parse");
+
+			CWeatherGeneratorOptions options;
+			msg = options.parse(str_options);
+
+			if (msg)
+			{
+				timer.start("Elevation");
+				if (options.m_elevation < -100)
+					msg = ComputeElevation(options.m_latitude, options.m_longitude, options.m_elevation);
+
+				if (msg)
+				{
+					CLocation location(options.m_name, options.m_ID, options.m_latitude, options.m_longitude, options.m_elevation);
+
+					//Load WGInput
+					//CWGInput WGInput = options.GetWGInput();
+					CWGInput WGInput;
+					options.GetWGInput(WGInput);
+
+					CRandomGenerator rand(WGInput.m_seed);
+					unsigned long seed = 1 + rand.Rand();
+
+					CWeatherGeneratorPtr pWG;
+					msg = CreateWeatherGenerator(pWG);
+
+					//station search and gradient
+					timer.start("Normals");
+					CNormalsStation normals;
+					if (msg)
 					{
-						m_elevation = ToDouble(option[1]);
-						if (m_elevation < -100 || m_elevation >8000)
-							msg.ajoute(option[1] + " is not a valid elevation. Elevation can by missing or between -100 and 8000 meters.");
-						break;
+						pWG->SetSeed(seed);
+						pWG->SetNbReplications(options.m_replications);
+						pWG->SetWGInput(WGInput);
+						pWG->SetTarget(location);
+						msg = pWG->GetNormals(normals, callback);
 					}
-					case SLOPE:					m_slope = ToDouble(option[1]); break;
-					case ORIENTATION:			m_orientation = ToDouble(option[1]); break;
-					case NB_NEAREST_NEIGHBOR:
-					{
-						m_nb_nearest_neighbor = ToSizeT(option[1]);
-						if (m_nb_nearest_neighbor == 0)
-							msg.ajoute(option[1] + " is not a valid nearest neighbor. nearest neighbor.");
 
-						break;
-					}
-					case FIRST_YEAR:
+
+					if (msg)
 					{
-						m_first_year = ToInt(option[1]);
-						if (m_first_year < 1900 || m_first_year>GetCurrentYear())
-							msg.ajoute(option[1] + " is not a valid year. First year must between 1900 and current year.");
+						// Compress
+						std::stringstream stream;
+						//CStatistic::SetVMiss(-999);
 
-						break;
+						boost::iostreams::filtering_streambuf<boost::iostreams::input> out;
+						if (options.m_compress)
+						{
+							boost::iostreams::gzip_params p;
+							p.file_name = "data.csv";
+							out.push(boost::iostreams::gzip_compressor(p));
+						}
+						out.push(stream);
+
+						timer.start("Serialization");
+						SaveNormals(stream, normals);
+						//zen::XmlElement root("Metadata");
+						//zen::writeStruc(location, root.addChild(CLocation::GetXMLFlag()));
+						//pugi::xml_document doc;
+
+						// Add a declaration
+						//pugi::xml_node declaration = doc.append_child(pugi::node_declaration);
+						//declaration.append_attribute("version") = "1.0";
+						//declaration.append_attribute("encoding") = "UTF-8";
+
+						// Create the root node
+						//pugi::xml_node root = doc.append_child("Metadata");
+						std::string json_str;
+						output.m_metadata = json_str;
+
+
+						timer.start("Compression");
+						std::stringstream compressed;
+						boost::iostreams::copy(out, compressed);
+
+						output.m_compress = options.m_compress;
+						output.m_data = compressed.str();
 					}
-					case LAST_YEAR:
+				}
+			}	// if (msg)
+
+		}
+		catch (...)
+		{
+			int i;
+			i = 0;
+		}
+
+		output.m_msg = get_string(msg);
+		output.m_comment = ANSI_UTF8(callback.GetMessages());
+		SetTiming(output, timer);
+
+		return output;
+
+	}
+
+
+	void CWeatherGeneratorAPI::SaveNormals(std::ostream& out, const CNormalsStation& normals)
+	{
+		string end_line = "\r\n";
+
+		//write header
+		out << "Month";
+		for (size_t f = 0; f != NB_FIELDS; f++)
+			out << ',' << GetFieldHeader(f);
+
+		out << end_line;
+
+		for (size_t m = 0; m != normals.size(); m++)
+		{
+			string line = FormatA("%02d", int(m + 1));
+
+			for (size_t f = 0; f != normals[m].size(); f++)
+			{
+				if (!IsMissing(normals[m][f]))
+				{
+					string format = "%7." + to_string(GetNormalDataPrecision((int)f)) + "f";
+					string value = FormatA(format.c_str(), normals[m][f]);
+					line += "," + value;
+				}
+				else
+				{
+					line += ", -999.0";
+				}
+
+			}
+
+			out << line << end_line;
+		}
+	}
+
+
+	//******************************************************************************************************************************
+	const char* CModelExecutionOptions::PARAM_NAME[NB_PAPAMS] =
+	{
+		"PARAMETERS", "REPLICATIONS", "SEED", "COMPRESS", "STATISTICS"
+	};
+
+	CModelExecutionOptions::CModelExecutionOptions()
+	{
+		m_replications = 1;
+		m_seed = 0;
+		m_compress = true;
+	}
+
+	ERMsg CModelExecutionOptions::parse(const string& str_options)
+	{
+		ERMsg msg;
+
+		vector<string> args = Tokenize(str_options, "&");
+		for (size_t i = 0; i < args.size(); i++)
+		{
+			vector<string> option = Tokenize(args[i], "=");
+			if (option.size() == 2)
+			{
+				//auto it = std::find(begin(PARAM_NAME), end(PARAM_NAME), MakeUpper(option[0]));
+				auto it = std::find_if(begin(PARAM_NAME), end(PARAM_NAME), [&str1 = option[0]](const auto& str2) { return boost::iequals(str1, str2); });
+				if (it != end(PARAM_NAME))
+				{
+					size_t o = distance(begin(PARAM_NAME), it);
+					switch (o)
 					{
-						m_last_year = ToInt(option[1]);
-						if (m_last_year < 1900 || m_last_year>GetCurrentYear())
-							msg.ajoute(option[1] + " is not a valid year. Last year must between 1900 and current year.");
+					case PARAMETERS:	m_parameters = option[1]; break;
+					case STATISTICS:
+					{
+						m_statistics = Tokenize(option[1], "+");
+						for (size_t s = 0; s < m_statistics.size(); s++)
+						{
+							string stat = MakeUpper(Trim(m_statistics[s]));
+							bool bQuantile = stat.size() > 1 && stat[0] == 'Q' && stat.find_first_not_of("0123456789.", 1) == string::npos && ToDouble(stat.substr(1)) <= 100;
+							if (stat != "MEAN" && stat != "SD" && stat != "MIN" && stat != "MAX" && !bQuantile)
+								msg.ajoute(m_statistics[s] + " is not a valid statistic. Select Mean, SD, Min, Max or Q followed by a percentile (ex.: Q50).");
 
+							m_statistics[s] = stat;
+						}
 						break;
 					}
-					case NB_YEARS:			m_nb_years = ToInt(option[1]); break;
-					case SEED:				   m_seed = ToInt(option[1]); break;
-					case COMPRESS:			m_compress = ToBool(option[1]); break;
-					case REPLICATIONS:		   m_replications = ToInt(option[1]); break;
+					case SEED:			m_seed = ToInt(option[1]); break;
+					case COMPRESS:		m_compress = ToBool(option[1]); break;
+					case REPLICATIONS:	m_replications = ToInt(option[1]); break;
 					default: assert(false);
 					}
 				}
@@ -403,421 +2461,484 @@ namespace WBSF
 			}
 		}
 
-		if (m_first_year > m_last_year)
-			msg.ajoute("Last year (" + to_string(m_last_year) + ") must be greater or equal to first year (" + to_string(m_first_year) + ") .");
-
-
 		return msg;
 	}
 
 	//Load WGInput
-	void CWeatherGeneratorOptions::GetWGInput(CWGInput& WGInput)const
+	ERMsg CModelExecutionOptions::GetModelInput(const CModel& model, CModelInput& modelInput)const
 	{
-		//Load WGInput
-		//CWGInput WGInput;
+		//first set of a sweep, with escapes removed
+		return GetModelInput(model, GetParameterSets().front(), modelInput);
+	}
 
+	ERMsg CModelExecutionOptions::GetModelInput(const CModel& model, const std::string& parameters, CModelInput& modelInput)
+	{
+		ERMsg msg;
 
-		WGInput.m_variables = m_variables;
-		WGInput.m_sourceType = m_sourceType;
-		WGInput.m_generationType = m_generationType;
-		WGInput.m_nbNormalsYears = m_nb_years;
-		WGInput.m_firstYear = m_first_year;
-		WGInput.m_lastYear = m_last_year;
-		WGInput.m_bUseForecast = true;
-		WGInput.m_bUseGribs = false;
+		//Get default parameters
+		model.GetDefaultParameter(modelInput);
 
-		WGInput.m_nbNormalsStations = m_nb_nearest_neighbor;
-		WGInput.m_nbDailyStations = m_nb_nearest_neighbor;
-		WGInput.m_nbHourlyStations = m_nb_nearest_neighbor;
-		WGInput.m_nbGribPoints = m_nb_nearest_neighbor;
-		//WGInput.m_albedo;
-		WGInput.m_seed = m_seed;
-		WGInput.m_bXValidation = false;
-		WGInput.m_bSkipVerify = true;
-		WGInput.m_bNoFillMissing = false;
-		WGInput.m_bUseShore = true;
-		//CWVariables m_allowedDerivedVariables;
-		//CSearchRadius m_searchRadius;
+		//update parameters
+		vector<string> args = Tokenize(parameters, "+");//parameters separate by space, must not have space in name
+		for (size_t i = 0; i < args.size(); i++)
+		{
+			vector<string> option = Tokenize(args[i], ":");
+			if (option.size() == 2)
+			{
+				string name = option[0];
+				auto it = find_if(modelInput.begin(), modelInput.end(), [name](const CModelInputParam& m) -> bool { return WBSF::IsEqual(m.m_name, name); });
+				if (it != modelInput.end())
+				{
+					it->m_value = option[1];
+				}
+				else
+				{
+					msg.ajoute("Invalid model input parameters " + to_string(i + 1) + "( " + args[i] + ")");
+				}
+			}
+			else
+			{
+				msg.ajoute("error in  model input parameters  " + to_string(i + 1) + "( " + args[i] + ")");
+			}
+		}
 
-		//return WGInput;
+		return msg;
 	}
 
+	//split at the delimiters not escaped by "\". Escapes are kept for the next split. Empty tokens are removed, as Tokenize.
+	static vector<string> TokenizeEscaped(const string& str, char delimiter)
+	{
+		vector<string> tokens(1);
+		for (size_t i = 0; i < str.size(); i++)
+		{
+			if (str[i] == '\\' && i + 1 < str.size())
+			{
+				tokens.back() += str[i];
+				tokens.back() += str[++i];
+			}
+			else if (str[i] == delimiter)
+			{
+				tokens.emplace_back();
+			}
+			else
+			{
+				tokens.back() += str[i];
+			}
+		}
 
-	//******************************************************************************************************************************
+		tokens.erase(std::remove_if(tokens.begin(), tokens.end(), [](const string& t) { return t.empty(); }), tokens.end());
+		return tokens;
+	}
 
-	//CCriticalSection m_CS;//to protect shore
-	std::mutex m_mutex;//to protect shore
+	static string UnescapeValue(const string& str)
+	{
+		string value;
+		for (size_t i = 0; i < str.size(); i++)
+		{
+			if (str[i] == '\\' && i + 1 < str.size())
+				i++;
 
+			value += str[i];
+		}
 
+		return value;
+	}
 
-	CWeatherGeneratorAPI::CWeatherGeneratorAPI(const std::string&)
+	static string EscapeValue(const string& str)
 	{
-	}
+		string value;
+		for (char c : str)
+		{
+			if (c == '\\' || c == ';' || c == '|')
+				value += '\\';
 
+			value += c;
+		}
 
+		return value;
+	}
 
-	std::string CWeatherGeneratorAPI::Initialize(const std::string& str_init)
+	//Parameters sets of a sweep. Sets are separated by ";" and values of a grid by "|":
+	//"A:1+B:2;A:3+B:4" give 2 sets and "A:1|2+B:3|4" give the 4 combinations (A varies slowest).
+	//A value that contains ";", "|" or "\" must escape them with "\": "A:x\;y" is one set with A = "x;y".
+	//Returned sets have their escapes removed.
+	std::vector<std::string> CModelExecutionOptions::GetParameterSets()const
 	{
-		ERMsg msg;
-
+		vector<string> sets;
 
+		vector<string> lists = TokenizeEscaped(m_parameters, ';');
+		if (lists.empty())
+			lists.push_back("");
 
-		msg = m_init.parse(str_init);
-
-		if (msg)
+		for (size_t l = 0; l < lists.size(); l++)
 		{
-			try
-			{
-
-				CCallback callback;
-				if (!m_init.m_normal_name.empty())
-				{
-					m_pNormalDB.reset(new CNormalsDatabase);
-
+			vector<string> combinations = { "" };
 
-					if (IsEqual(GetFileExtension(m_init.m_normal_name), ".NormalsDB"))
-					{
-						msg += m_pNormalDB->Open(m_init.m_normal_name);
+			vector<string> args = Tokenize(lists[l], "+");
+			for (size_t i = 0; i < args.size(); i++)
+			{
+				vector<string> option = Tokenize(args[i], ":");
+				vector<string> values = option.size() == 2 ? TokenizeEscaped(option[1], '|') : vector<string>();
+				if (values.empty())
+					values.push_back(option.size() == 2 ? option[1] : string());
 
-						if (msg)
-							m_pNormalDB->OpenSearchOptimization(callback);
-					}
-					else if (IsEqual(GetFileExtension(m_init.m_normal_name), ".gz"))
-					{
-						msg += m_pNormalDB->LoadFromBinary(m_init.m_normal_name);
-						if (msg)
-							m_pNormalDB->CreateAllCanals();
-					}
-					else
-					{
-						msg.ajoute("Invalid Normals database extension: " + m_init.m_normal_name);
-					}
+				for (size_t v = 0; v < values.size(); v++)
+					values[v] = UnescapeValue(values[v]);
 
-					if (!m_init.m_daily_name.empty())
+				vector<string> next;
+				for (size_t c = 0; c < combinations.size(); c++)
+				{
+					for (size_t v = 0; v < values.size(); v++)
 					{
-						m_pDailyDB.reset(new CDailyDatabase(int(pGLOBAL_DLL_DATA->m_daily_cache_size)));
-
-
-						if (IsEqual(GetFileExtension(m_init.m_daily_name), ".DailyDB"))
-						{
-							msg += m_pDailyDB->Open(m_init.m_daily_name, CDailyDatabase::modeRead, callback, true);
-							if (msg)
-								msg += m_pDailyDB->OpenSearchOptimization(callback);//open here to be thread safe
-						}
-						else if (IsEqual(GetFileExtension(m_init.m_daily_name), ".gz"))
-						{
-							msg += m_pDailyDB->LoadFromBinary(m_init.m_daily_name);
-							if (msg)
-								m_pDailyDB->CreateAllCanals();
-						}
-						else
-						{
-							msg.ajoute("Invalid Daily database extension: " + m_init.m_daily_name);
-						}
-						//}
+						//invalid parameters are kept as is: GetModelInput report them
+						string param = option.size() == 2 ? option[0] + ":" + values[v] : args[i];
+						next.push_back(combinations[c] + (combinations[c].empty() ? "" : "+") + param);
 					}
 				}
 
-				if (msg)
-				{
-					m_pWeatherGenerator.reset(new CWeatherGenerator);
-					m_pWeatherGenerator->SetNormalDB(m_pNormalDB);
-					m_pWeatherGenerator->SetDailyDB(m_pDailyDB);
-				}
-			}
-			catch (...)
-			{
-				int i;
-				i = 0;
+				combinations.swap(next);
 			}
+
+			sets.insert(sets.end(), combinations.begin(), combinations.end());
 		}
 
-		return get_string(msg);
+		return sets;
 	}
 
-
-	ERMsg CWeatherGeneratorAPI::ComputeElevation(double latitude, double longitude, double& elevation)
+	//canonical form of the options: parameters are sorted and names are in upper case
+	std::string CModelExecutionOptions::GetCanonical()const
 	{
-		ERMsg msg;
+		vector<string> sets = GetParameterSets();
 
-		if (pGLOBAL_DLL_DATA->m_pDEM && pGLOBAL_DLL_DATA->m_pDEM->IsOpen())
+		string str = "PARAMETERS=";
+		for (size_t s = 0; s < sets.size(); s++)
 		{
-			CGeoPoint pt(longitude, latitude, PRJ_WGS_84);
-
-			CGeoPointIndex xy = pGLOBAL_DLL_DATA->m_pDEM->GetExtents().CoordToXYPos(pt);
-			if (pGLOBAL_DLL_DATA->m_pDEM->GetExtents().is_inside(xy))
-			{
-				elevation = pGLOBAL_DLL_DATA->m_pDEM->ReadPixel(0, xy);
-
-				if (fabs(elevation - pGLOBAL_DLL_DATA->m_pDEM->GetNoData(0)) < 0.1)
-				{
-					msg.ajoute("DEM is not available for the lat/lon coordinate.");
-				}
-			}
-			else
+			vector<string> args = Tokenize(sets[s], "+");
+			for (size_t i = 0; i < args.size(); i++)
 			{
-				msg.ajoute("Lat/lon outside DEM extents.");
+				vector<string> option = Tokenize(args[i], ":");
+				if (option.size() == 2)
+					args[i] = MakeUpper(Trim(option[0])) + ":" + EscapeValue(Trim(option[1]));
 			}
-		}
-		else
-		{
-			msg.ajoute("Elevation and DEM is not provided. Invalid elevation.");
+
+			std::sort(args.begin(), args.end());
+
+			str += s == 0 ? "" : ";";
+			for (size_t i = 0; i < args.size(); i++)
+				str += (i == 0 ? "" : "+") + args[i];
 		}
 
-		return msg;
+		str += "&REPLICATIONS=" + to_string(m_replications);
+		str += "&SEED=" + to_string(m_seed);
+		str += "&COMPRESS=" + to_string(m_compress);
+
+		str += "&STATISTICS=";
+		for (size_t s = 0; s < m_statistics.size(); s++)
+			str += (s == 0 ? "" : "+") + m_statistics[s];
+
+		return str;
 	}
 
+	//******************************************************************************************************************************
 
-	CTeleIO CWeatherGeneratorAPI::Generate(const std::string& str_options)
+	//P² streaming quantile estimator (Jain and Chlamtac, 1985): constant memory, exact for less than 5 values
+	class CP2Quantile
 	{
-		assert(m_pWeatherGenerator != nullptr);
-
-		ERMsg msg;
-		CCallback callback;
-		CTeleIO output;
-		//string output;
+	public:
 
-		try
+		CP2Quantile(double p = 0.5)
 		{
-			boost::timer::cpu_timer timer;
-			timer.start();
-
-			CWeatherGeneratorOptions options;
-			msg = options.parse(str_options);
+			m_p = p;
+			m_count = 0;
+		}
 
-			if (msg)
+		void add(double x)
+		{
+			if (m_count < 5)
 			{
+				m_q[m_count++] = x;
+				if (m_count == 5)
+				{
+					std::sort(m_q.begin(), m_q.end());
+					m_n = { 0, 1, 2, 3, 4 };
+					m_np = { 0, 2 * m_p, 4 * m_p, 2 + 2 * m_p, 4 };
+					m_dn = { 0, m_p / 2, m_p, (1 + m_p) / 2, 1 };
+				}
 
-				if (options.m_elevation < -100)
-					msg = ComputeElevation(options.m_latitude, options.m_longitude, options.m_elevation);
+				return;
+			}
 
-				if (msg)
-				{
-					CLocation location(options.m_name, options.m_ID, options.m_latitude, options.m_longitude, options.m_elevation);
+			//find the cell of x and update extreme markers
+			size_t k = 0;
+			if (x < m_q[0])
+			{
+				m_q[0] = x;
+			}
+			else if (x >= m_q[4])
+			{
+				m_q[4] = x;
+				k = 3;
+			}
+			else
+			{
+				while (x >= m_q[k + 1])
+					k++;
+			}
 
-					//Load WGInput
-					CWGInput WGInput;
-					options.GetWGInput(WGInput);
+			for (size_t i = k + 1; i < 5; i++)
+				m_n[i]++;
 
-					//init random generator
-					CRandomGenerator rand(WGInput.m_seed);
-					unsigned long seed = 1 + rand.Rand();
+			for (size_t i = 0; i < 5; i++)
+				m_np[i] += m_dn[i];
 
-					m_pWeatherGenerator->SetSeed(seed);
-					m_pWeatherGenerator->SetNbReplications(options.m_replications);
-					m_pWeatherGenerator->SetWGInput(WGInput);
-					m_pWeatherGenerator->SetTarget(location);
+			//adjust middle markers
+			for (size_t i = 1; i < 4; i++)
+			{
+				double d = m_np[i] - m_n[i];
+				if ((d >= 1 && m_n[i + 1] - m_n[i] > 1) || (d <= -1 && m_n[i - 1] - m_n[i] < -1))
+				{
+					int s = d >= 0 ? 1 : -1;
+					double q = m_q[i] + s / (m_n[i + 1] - m_n[i - 1]) * ((m_n[i] - m_n[i - 1] + s) * (m_q[i + 1] - m_q[i]) / (m_n[i + 1] - m_n[i]) + (m_n[i + 1] - m_n[i] - s) * (m_q[i] - m_q[i - 1]) / (m_n[i] - m_n[i - 1]));
+					if (m_q[i - 1] < q && q < m_q[i + 1])
+						m_q[i] = q;
+					else
+						m_q[i] = m_q[i] + s * (m_q[i + s] - m_q[i]) / (m_n[i + s] - m_n[i]);
 
-					msg = m_pWeatherGenerator->Generate();
+					m_n[i] += s;
+				}
+			}
 
-					if (msg)
-					{
-						std::bitset<CWeatherGenerator::NB_WARNING> warning = m_pWeatherGenerator->GetWarningBits();
+			m_count++;
+		}
 
+		double get()const
+		{
+			if (m_count == 0)
+				return -999;
 
-						// Compress
-						std::stringstream sender;
-						CStatistic::SetVMiss(-999);
+			if (m_count < 5)
+			{
+				std::array<double, 5> q = m_q;
+				std::sort(q.begin(), q.begin() + m_count);
 
-						boost::iostreams::filtering_streambuf<boost::iostreams::input> out;
-						if (options.m_compress)
-						{
-							boost::iostreams::gzip_params p;
-							p.file_name = "data.csv";
-							out.push(boost::iostreams::gzip_compressor(p));
-						}
-						out.push(sender);
+				double pos = m_p * (m_count - 1);
+				size_t i = size_t(pos);
+				return (i + 1 < m_count) ? q[i] + (pos - i) * (q[i + 1] - q[i]) : q[i];
+			}
 
+			return m_q[2];
+		}
 
-						for (size_t r = 0; r < m_pWeatherGenerator->GetNbReplications() && msg; r++)
-						{
-							//write info and weather to the stream
-							const CSimulationPoint& weather = m_pWeatherGenerator->GetWeather(r);
-							CTM TM = weather.GetTM();
-							msg = ((CWeatherYears&)weather).SaveData(sender, TM, ',');
-
-						}   // for replication
-
-
-						// 3. Demonstrating implicit conversion for custom types (if `to_json()` is defined)
-						//class Point {
-						//public:
-						//	int x;
-						//	int y;
-						//	Point(int x_val, int y_val) : x(x_val), y(y_val) {}
-						//
-						//	// Custom to_json() function for serialization
-						//	json11::Json to_json() const {
-						//		return json11::Json::array{ x, y };
-						//	}
-						//};
-						//
-						//std::vector<Point> points = { { 1, 2 }, { 10, 20 } };
-						//nlohmann::json json("nom:4");
-						//std::string json_str = json.dump();
-						//std::cout << "\nSerialized Points vector:\n" << points_json_str << std::endl;
+	protected:
 
+		double m_p;
+		size_t m_count;
+		std::array<double, 5> m_q;//markers heights
+		std::array<double, 5> m_n;//markers positions
+		std::array<double, 5> m_np;//desired positions
+		std::array<double, 5> m_dn;//increments of desired positions
+	};
 
+	//Statistics of each time step and each output variable over all replications of a model.
+	//Results must be added in the same order to get the same quantiles.
+	class CReplicationStatistics
+	{
+	public:
 
-						//pugi::xml_document doc;
+		CReplicationStatistics(const std::vector<std::string>& statistics)
+		{
+			m_statistics = statistics;
+			for (size_t s = 0; s < m_statistics.size(); s++)
+				if (m_statistics[s][0] == 'Q')
+					m_p.push_back(ToDouble(m_statistics[s].substr(1)) / 100);
 
-						// Add a declaration
-						//pugi::xml_node declaration = doc.append_child(pugi::node_declaration);
-						//declaration.append_attribute("version") = "1.0";
-						//declaration.append_attribute("encoding") = "UTF-8";
+			m_rows = 0;
+			m_cols = 0;
+		}
 
+		ERMsg add(const CModelStatVector& result)
+		{
+			ERMsg msg;
 
+			if (m_stats.empty())
+			{
+				m_firstTRef = result.GetFirstTRef();
+				m_TM = result.GetTM();
+				m_rows = result.size();
+				m_cols = result.GetCols();
+				m_stats.resize(m_rows * m_cols);
+				m_quantiles.resize(m_rows * m_cols * m_p.size());
+				for (size_t i = 0; i < m_quantiles.size(); i++)
+					m_quantiles[i] = CP2Quantile(m_p[i % m_p.size()]);
+			}
 
-						// Create the root node
-						//pugi::xml_node root = doc.append_child("Metadata");
-						//
-						//// Add elements and attributes
-						//pugi::xml_node locNode = root.append_child(CLocationVector::XML_FLAG);
-						////locNode.append_child(pugi::node_pcdata).set_value("VALUIE");
-						////string OK = locNode.value();
-						//
-						//location.write_xml(locNode);
-						//CLocation test;
-						//
-						//test.read_xml(locNode);
-						//
-						////zen::XmlElement root("Metadata");
-						////zen::writeStruc(location, root.addChild(CLocation::GetXMLFlag()));
-						//std::stringstream ss;
-						//doc.save(ss);
-						//output.m_metadata = ss.str();
-
-						using namespace nlohmann::literals;
-
-						// Using initializer lists
-						nlohmann::json l =
-						{
-							{"Location",
-								{
-								{"ID", location.m_ID},
-								{"Name", location.m_name},
-								{"Latitude", location.m_lat},
-								{ "Longitude", location.m_lon },
-								{ "Elevation", location.m_elev }
-								}
-							}
-						};
+			if (result.size() != m_rows || result.GetCols() != m_cols)
+			{
+				msg.ajoute("Replications results don't have the same number of rows and columns. Statistics cannot be computed.");
+				return msg;
+			}
 
+			for (size_t r = 0; r < m_rows; r++)
+			{
+				for (size_t c = 0; c < m_cols; c++)
+				{
+					double value = result[r][c];
+					if (!IsMissing(value))
+					{
+						m_stats[r * m_cols + c] += value;
+						for (size_t q = 0; q < m_p.size(); q++)
+							m_quantiles[(r * m_cols + c) * m_p.size() + q].add(value);
+					}
+				}
+			}
 
-						output.m_metadata = l.dump();
+			return msg;
+		}
 
-						std::stringstream compressed;
-						boost::iostreams::copy(out, compressed);
+		void save(std::ostream& out, const std::vector<std::string>& variables)const
+		{
+			bool bMonth = m_TM.Type() == CTM::MONTHLY || m_TM.Type() == CTM::DAILY || m_TM.Type() == CTM::HOURLY;
+			bool bDay = m_TM.Type() == CTM::DAILY || m_TM.Type() == CTM::HOURLY;
+			bool bHour = m_TM.Type() == CTM::HOURLY;
 
-						output.m_compress = options.m_compress;
-						output.m_data = compressed.str();
+			out << "Year" << (bMonth ? ",Month" : "") << (bDay ? ",Day" : "") << (bHour ? ",Hour" : "");
+			for (size_t c = 0; c < m_cols; c++)
+				for (size_t s = 0; s < m_statistics.size(); s++)
+					out << "," << (c < variables.size() ? variables[c] : to_string(c + 1)) << "_" << m_statistics[s];
+			out << "\n";
 
+			for (size_t r = 0; r < m_rows; r++)
+			{
+				CTRef TRef = m_firstTRef + int(r);
+				out << TRef.GetYear();
+				if (bMonth)
+					out << "," << TRef.GetMonth() + 1;
+				if (bDay)
+					out << "," << TRef.GetDay() + 1;
+				if (bHour)
+					out << "," << TRef.GetHour();
+
+				for (size_t c = 0; c < m_cols; c++)
+				{
+					const CStatistic& stat = m_stats[r * m_cols + c];
+					size_t q = 0;
+					for (size_t s = 0; s < m_statistics.size(); s++)
+					{
+						double value = -999;
+						if (m_statistics[s] == "MEAN")
+							value = stat.IsInit() ? stat[CStatistic::MEAN] : -999;
+						else if (m_statistics[s] == "SD")
+							value = stat.IsInit() ? stat[CStatistic::STD_DEV] : -999;
+						else if (m_statistics[s] == "MIN")
+							value = stat.IsInit() ? stat[CStatistic::LOWEST] : -999;
+						else if (m_statistics[s] == "MAX")
+							value = stat.IsInit() ? stat[CStatistic::HIGHEST] : -999;
+						else
+							value = m_quantiles[(r * m_cols + c) * m_p.size() + q++].get();
 
-						CWVariablesCounter missing = m_pWeatherGenerator->GetMissingCount();
-						CWeatherGenerator::OutputWarning(warning, missing, callback);
+						out << "," << value;
 					}
 				}
-			}	// if (msg)
 
-			timer.stop();
-
-		}
-		catch (...)
-		{
-			int i;
-			i = 0;
+				out << "\n";
+			}
 		}
 
-		output.m_msg = get_string(msg);
-		output.m_comment = ANSI_UTF8(callback.GetMessages());
+	protected:
+
+		std::vector<std::string> m_statistics;
+		std::vector<double> m_p;
+
+		CTRef m_firstTRef;
+		CTM m_TM;
+		size_t m_rows;
+		size_t m_cols;
+		std::vector<CStatistic> m_stats;
+		std::vector<CP2Quantile> m_quantiles;
+	};
+
 
-		return output;
-	}
+	const std::array<const char*, CModelExecutionAPI::NB_PAPAMS> CModelExecutionAPI::PARAM_NAME = { "MODEL", "CACHESIZE", "THREADSAFE" };
 
 
-	CTeleIO CWeatherGeneratorAPI::GetNormals(const std::string& str_options)
+	CModelExecutionAPI::CModelExecutionAPI(const std::string&)
+	{
+		m_pSingleFlight = make_shared<CSingleFlight>();
+		m_bThreadSafe = false;
+	}
+
+	std::string CModelExecutionAPI::Initialize(const std::string& str_options)
 	{
 		ERMsg msg;
-		CCallback callback;
-		CTeleIO output;
 
 		try
 		{
-			boost::timer::cpu_timer timer;
-			timer.start();
-
-			CWeatherGeneratorOptions options;
-			msg = options.parse(str_options);
+			CCallback callback;
 
-			if (msg)
+			vector<string> args = Tokenize(str_options, "&");
+			for (size_t i = 0; i < args.size(); i++)
 			{
-
-				if (options.m_elevation < -100)
-					msg = ComputeElevation(options.m_latitude, options.m_longitude, options.m_elevation);
-
-				if (msg)
+				vector<string> option = Tokenize(args[i], "=");
+				if (option.size() == 2)
 				{
-					CLocation location(options.m_name, options.m_ID, options.m_latitude, options.m_longitude, options.m_elevation);
-
-					//Load WGInput
-					//CWGInput WGInput = options.GetWGInput();
-					CWGInput WGInput;
-					options.GetWGInput(WGInput);
-
-					CRandomGenerator rand(WGInput.m_seed);
-					unsigned long seed = 1 + rand.Rand();
+					string key = Trim(option[0]);
+					
+					auto it = std::find_if(PARAM_NAME.begin(), PARAM_NAME.end(), [&str1 = key](const auto& str2) { return boost::iequals(str1, str2); });
+					if (it != PARAM_NAME.end())
+					{
+						size_t o = distance(PARAM_NAME.begin(), it);
+						switch (o)
+						{
+						case MODEL:
+						{
 
-					m_pWeatherGenerator->SetSeed(seed);
-					m_pWeatherGenerator->SetNbReplications(options.m_replications);
-					m_pWeatherGenerator->SetWGInput(WGInput);
-					m_pWeatherGenerator->SetTarget(location);
+							m_pModel.reset();
+							m_pModelMutex.reset();
 
-					CNormalsStation normals;
-					msg = m_pWeatherGenerator->GetNormals(normals, callback);
+							string model_file_path = Trim(option[1]);
+							if (WBSF::GetPath(model_file_path).empty() && !pGLOBAL_DLL_DATA->m_model_path.empty())
+							{
+								model_file_path = pGLOBAL_DLL_DATA->m_model_path + model_file_path;
+								if (!IsEqualNoCase(GetFileExtension(model_file_path), ".mdl"))
+									model_file_path += ".mdl";
+							}
 
+							//already loaded models are shared
+							msg += MODEL_REGISTRY.get(model_file_path, m_pModel, m_pModelMutex);
 
-					if (msg)
-					{
-						// Compress
-						std::stringstream stream;
-						//CStatistic::SetVMiss(-999);
+							//results of the previous model are no longer valid
+							if (m_pCache)
+								m_pCache->clear();
 
-						boost::iostreams::filtering_streambuf<boost::iostreams::input> out;
-						if (options.m_compress)
-						{
-							boost::iostreams::gzip_params p;
-							p.file_name = "data.csv";
-							out.push(boost::iostreams::gzip_compressor(p));
+							break;
 						}
-						out.push(stream);
-
-						SaveNormals(stream, normals);
-						//zen::XmlElement root("Metadata");
-						//zen::writeStruc(location, root.addChild(CLocation::GetXMLFlag()));
-						//pugi::xml_document doc;
-
-						// Add a declaration
-						//pugi::xml_node declaration = doc.append_child(pugi::node_declaration);
-						//declaration.append_attribute("version") = "1.0";
-						//declaration.append_attribute("encoding") = "UTF-8";
 
-						// Create the root node
-						//pugi::xml_node root = doc.append_child("Metadata");
-						std::string json_str;
-						output.m_metadata = json_str;
+						case CACHE_SIZE:
+						{
+							size_t cache_size = ToSizeT(Trim(option[1]));
+							if (cache_size > 0)
+								m_pCache = make_shared<CTeleIOCache>(cache_size * 1024 * 1024);
+							else
+								m_pCache.reset();
 
+							break;
+						}
 
-						std::stringstream compressed;
-						boost::iostreams::copy(out, compressed);
+						case THREAD_SAFE: m_bThreadSafe = ToBool(Trim(option[1])); break;
 
-						output.m_compress = options.m_compress;
-						output.m_data = compressed.str();
+						default: assert(false);
+						}
+					}
+					else
+					{
+						msg.ajoute("Invalid options in argument " + to_string(i + 1) + "( " + args[i] + ")");
 					}
 				}
-			}	// if (msg)
-
-			timer.stop();
-
+				else
+				{
+					msg.ajoute("error in argument " + to_string(i + 1) + "( " + args[i] + ")");
+				}
+			}
 		}
 		catch (...)
 		{
@@ -825,364 +2946,517 @@ namespace WBSF
 			i = 0;
 		}
 
-		output.m_msg = get_string(msg);
-		output.m_comment = ANSI_UTF8(callback.GetMessages());
+		return get_string(msg);
+	}
 
-		return output;
 
+	CTeleIO CModelExecutionAPI::Execute(const std::string& str_options, const CTeleIO& input)
+	{
+		return Execute(str_options, CTeleIOView(input));
 	}
 
-
-	void CWeatherGeneratorAPI::SaveNormals(std::ostream& out, const CNormalsStation& normals)
+	//the input data is used in place, without any copy
+	CTeleIO CModelExecutionAPI::Execute(const std::string& str_options, const CTeleIOView& input)
 	{
-		string end_line = "\r\n";
+		assert(m_pModel);
 
-		//write header
-		out << "Month";
-		for (size_t f = 0; f != NB_FIELDS; f++)
-			out << ',' << GetFieldHeader(f);
+		CTeleIO output;
 
-		out << end_line;
+		if (m_pModel.get() == nullptr)
+		{
+			output.m_msg = "Model is not define yet. Call Initialize first";
+			return output;
+		}
 
-		for (size_t m = 0; m != normals.size(); m++)
+
+		CPhaseTimer timer;
+		timer.start("Parse");
+
+		CModelExecutionOptions options;
+		ERMsg msg = options.parse(str_options);
+		if (!msg)
 		{
-			string line = FormatA("%02d", int(m + 1));
+			output.m_msg = get_string(msg);
+			output.m_comment = ANSI_UTF8("");
+			SetTiming(output, timer);
+			return output;
+		}
 
-			for (size_t f = 0; f != normals[m].size(); f++)
-			{
-				if (!IsMissing(normals[m][f]))
-				{
-					string format = "%7." + to_string(GetNormalDataPrecision((int)f)) + "f";
-					string value = FormatA(format.c_str(), normals[m][f]);
-					line += "," + value;
-				}
-				else
-				{
-					line += ", -999.0";
-				}
+		//random requests are always executed
+		if (options.m_seed == 0)
+			return ExecuteOutput(options, input, timer);
 
-			}
+		//deterministic requests are cached and identical concurrent requests are executed only once.
+		//The key is the model, the options and a digest of the input content (metadata and decompressed data, not the timing).
+		string digest = GetHashKey(input);
+		if (digest.empty())
+			return ExecuteOutput(options, input, timer);
 
-			out << line << end_line;
+		string key = "MODEL=" + m_pModel->GetName() + "&" + options.GetCanonical() + "&INPUT=" + digest;
+		if (m_pCache)
+		{
+			timer.start("Cache");
+			if (m_pCache->get(key, output))
+			{
+				SetTiming(output, timer);
+				return output;
+			}
 		}
-	}
 
+		return m_pSingleFlight->Do(key, [&]()
+			{
+				CTeleIO result = ExecuteOutput(options, input, timer);
+				if (m_pCache && result.m_msg == get_string(ERMsg()))
+					m_pCache->set(key, result);
 
-	//******************************************************************************************************************************
-	const char* CModelExecutionOptions::PARAM_NAME[NB_PAPAMS] =
+				return result;
+			});
+	}
+
+	size_t CModelExecutionAPI::GetCacheHits()const
 	{
-		"PARAMETERS", "REPLICATIONS", "SEED", "COMPRESS"
-	};
+		return m_pCache ? m_pCache->hits() : 0;
+	}
 
-	CModelExecutionOptions::CModelExecutionOptions()
+	size_t CModelExecutionAPI::GetCacheMisses()const
 	{
-		m_replications = 1;
-		m_seed = 0;
-		m_compress = true;
+		return m_pCache ? m_pCache->misses() : 0;
 	}
 
-	ERMsg CModelExecutionOptions::parse(const string& str_options)
+	CTeleIO CModelExecutionAPI::ExecuteOutput(const CModelExecutionOptions& options, const CTeleIOView& input, CPhaseTimer& timer)const
 	{
-		ERMsg msg;
+		timer.start("LoadWeather");
+		CSimulationPointVector simulationPoints;
+		ERMsg msg = LoadWeather(input, simulationPoints);
+		timer.stop();
 
-		vector<string> args = Tokenize(str_options, "&");
-		for (size_t i = 0; i < args.size(); i++)
+		if (!msg)
 		{
-			vector<string> option = Tokenize(args[i], "=");
-			if (option.size() == 2)
-			{
-				//auto it = std::find(begin(PARAM_NAME), end(PARAM_NAME), MakeUpper(option[0]));
-				auto it = std::find_if(begin(PARAM_NAME), end(PARAM_NAME), [&str1 = option[0]](const auto& str2) { return boost::iequals(str1, str2); });
-				if (it != end(PARAM_NAME))
-				{
-					size_t o = distance(begin(PARAM_NAME), it);
-					switch (o)
-					{
-					case PARAMETERS:	m_parameters = option[1]; break;
-					case SEED:			m_seed = ToInt(option[1]); break;
-					case COMPRESS:		m_compress = ToBool(option[1]); break;
-					case REPLICATIONS:	m_replications = ToInt(option[1]); break;
-					default: assert(false);
-					}
-				}
-				else
-				{
-					msg.ajoute("Invalid options in argument " + to_string(i + 1) + "( " + args[i] + ")");
-				}
-			}
-			else
-			{
-				msg.ajoute("error in argument " + to_string(i + 1) + "( " + args[i] + ")");
-			}
+			CTeleIO output;
+			output.m_msg = get_string(msg);
+			output.m_comment = ANSI_UTF8("");
+			SetTiming(output, timer);
+			return output;
 		}
 
-		return msg;
+		return ExecuteWeather(options, simulationPoints, timer);
 	}
 
-	//Load WGInput
-	ERMsg CModelExecutionOptions::GetModelInput(const CModel& model, CModelInput& modelInput)const
+	//Generate weather and execute the model in one call: generated simulation points are 
+	//given directly to the model, without CSV serialization and parsing.
+	CTeleIO CModelExecutionAPI::Execute(const std::string& str_options, const CWeatherGeneratorAPI& weatherGen, const std::string& WG_options)
 	{
-		ERMsg msg;
+		assert(m_pModel);
 
-		//Get default parameters
-		model.GetDefaultParameter(modelInput);
+		CTeleIO output;
 
-		//update parameters
-		vector<string> args = Tokenize(m_parameters, "+");//parameters separate by space, must not have space in name
-		for (size_t i = 0; i < args.size(); i++)
+		if (m_pModel.get() == nullptr)
 		{
-			vector<string> option = Tokenize(args[i], ":");
-			if (option.size() == 2)
-			{
-				string name = option[0];
-				auto it = find_if(modelInput.begin(), modelInput.end(), [name](const CModelInputParam& m) -> bool { return WBSF::IsEqual(m.m_name, name); });
-				if (it != modelInput.end())
-				{
-					it->m_value = option[1];
-				}
-				else
-				{
-					msg.ajoute("Invalid model input parameters " + to_string(i + 1) + "( " + args[i] + ")");
-				}
-			}
-			else
-			{
-				msg.ajoute("error in  model input parameters  " + to_string(i + 1) + "( " + args[i] + ")");
-			}
+			output.m_msg = "Model is not define yet. Call Initialize first";
+			return output;
 		}
 
-		return msg;
-	}
+		CPhaseTimer timer;
+		timer.start("Parse");
 
-	//******************************************************************************************************************************
+		CModelExecutionOptions options;
+		ERMsg msg = options.parse(str_options);
 
+		CWeatherGeneratorOptions WGOptions;
+		msg += WGOptions.parse(WG_options);
 
-	const std::array<const char*, CModelExecutionAPI::NB_PAPAMS> CModelExecutionAPI::PARAM_NAME = { "MODEL" };
+		CCallback callback;
+		CSimulationPointVector simulationPoints;
+		if (msg)
+			msg = weatherGen.GenerateSimulationPoints(WGOptions, simulationPoints, callback, timer);
 
+		if (!msg)
+		{
+			output.m_msg = get_string(msg);
+			output.m_comment = ANSI_UTF8(callback.GetMessages());
+			SetTiming(output, timer);
+			return output;
+		}
 
-	CModelExecutionAPI::CModelExecutionAPI(const std::string&)
-	{
+		output = ExecuteWeather(options, simulationPoints, timer);
+
+		//weather generator warnings
+		output.m_comment = ANSI_UTF8(callback.GetMessages()) + output.m_comment;
 
+		return output;
 	}
 
-	std::string CModelExecutionAPI::Initialize(const std::string& str_options)
+	//Execute many models on the same weather: weather is loaded and parsed only once. One options string by model.
+	//Models are executed in parallel, one thread by model: runs of a model are then serial (nested parallel region).
+	//A model that is not thread-safe is still run by one thread at a time. Results of all models 
+	//are concatenated in the same order. The metadata give, for each model, the offset and size of its 
+	//results (uncompressed) and its own error message. Output is compressed if the first options request it.
+	CTeleIO CModelExecutionAPI::ExecuteModels(const std::vector<const CModelExecutionAPI*>& models, const std::vector<std::string>& str_options, const CTeleIOView& input)
 	{
+		CTeleIO output;
 		ERMsg msg;
+		CCallback callback;
+		CPhaseTimer timer;
 
 		try
 		{
-			CCallback callback;
-
-			vector<string> args = Tokenize(str_options, "&");
-			for (size_t i = 0; i < args.size(); i++)
-			{
-				vector<string> option = Tokenize(args[i], "=");
-				if (option.size() == 2)
-				{
-					string key = Trim(option[0]);
-					
-					auto it = std::find_if(PARAM_NAME.begin(), PARAM_NAME.end(), [&str1 = key](const auto& str2) { return boost::iequals(str1, str2); });
-					if (it != PARAM_NAME.end())
-					{
-						size_t o = distance(PARAM_NAME.begin(), it);
-						switch (o)
-						{
-						case MODEL:
-						{
+			timer.start("Parse");
 
-							m_pModel.reset(new CModel);
+			if (models.empty() || models.size() != str_options.size())
+				msg.ajoute("One options string must be given for each model");
 
-							string model_file_path = Trim(option[1]);
-							if (WBSF::GetPath(model_file_path).empty() && !pGLOBAL_DLL_DATA->m_model_path.empty())
-							{
-								model_file_path = pGLOBAL_DLL_DATA->m_model_path + model_file_path;
-								if (!IsEqualNoCase(GetFileExtension(model_file_path), ".mdl"))
-									model_file_path += ".mdl";
-							}
+			vector<CModelExecutionOptions> options(models.size());
+			for (size_t m = 0; m < models.size() && msg; m++)
+			{
+				if (models[m] == nullptr || models[m]->m_pModel.get() == nullptr)
+					msg.ajoute("Model " + to_string(m + 1) + " is not define yet. Call Initialize first");
+				else
+					msg += options[m].parse(str_options[m]);
+			}
 
-							msg += m_pModel->Load(model_file_path);
-							if (msg)
-								msg += m_pModel->LoadLibrary();
+			CSimulationPointVector simulationPoints;
+			if (msg)
+			{
+				timer.start("LoadWeather");
+				msg = LoadWeather(input, simulationPoints);
+			}
 
-							break;
-						}
+			timer.stop();
 
-						default: assert(false);
-						}
+			if (msg)
+			{
+				bool bCompress = options.front().m_compress;
+
+				//each model has its own timer, used only by the thread of the model
+				vector<CTeleIO> model_outputs(models.size());
+				vector<CPhaseTimer> model_timers(models.size());
+
+				timer.start("Execution");
+#pragma omp parallel for schedule(dynamic, 1) num_threads(WBSF::GetNbCPU()) if (models.size() > 1)
+				for (int m = 0; m < (int)models.size(); m++)
+				{
+					try
+					{
+						//sections are compressed together
+						options[m].m_compress = false;
+						model_outputs[m] = models[m]->ExecuteWeather(options[m], simulationPoints, model_timers[m]);
 					}
-					else
+					catch (...)
 					{
-						msg.ajoute("Invalid options in argument " + to_string(i + 1) + "( " + args[i] + ")");
+						model_outputs[m].m_msg = "Unexpected error for model " + to_string(m + 1);
 					}
 				}
-				else
+				timer.stop();
+
+				nlohmann::json metadata = nlohmann::json::array();
+				std::stringstream sender;
+				size_t offset = 0;
+				for (size_t m = 0; m < models.size(); m++)
 				{
-					msg.ajoute("error in argument " + to_string(i + 1) + "( " + args[i] + ")");
+					timer.add(model_timers[m]);
+
+					const CTeleIO& model_output = model_outputs[m];
+
+					nlohmann::json section;
+					section["Name"] = models[m]->m_pModel->GetName();
+					section["Msg"] = model_output.m_msg;
+					section["Offset"] = offset;
+					section["Size"] = model_output.m_data.size();
+					metadata.push_back(section);
+
+					sender << model_output.m_data;
+					offset += model_output.m_data.size();
+
+					if (model_output.m_msg != get_string(ERMsg()))
+						msg.ajoute(models[m]->m_pModel->GetName() + ": " + model_output.m_msg);
+
+					if (!model_output.m_comment.empty() && model_output.m_comment != ANSI_UTF8(""))
+						callback.AddMessage(models[m]->m_pModel->GetName() + ": " + model_output.m_comment);
 				}
+
+				nlohmann::json m = { {"Models", metadata} };
+				output.m_metadata = m.dump();
+
+				// Compress
+				timer.start("Compression");
+				output.m_compress = bCompress;
+				output.m_data = GetData(sender, bCompress);
+				timer.stop();
 			}
 		}
-		catch (...)
+		catch (const std::exception& e)
 		{
-			int i;
-			i = 0;
+			msg.ajoute(e.what());
 		}
 
-		return get_string(msg);
-	}
+		output.m_msg = get_string(msg);
+		output.m_comment = ANSI_UTF8(callback.GetMessages());
+		SetTiming(output, timer);
 
+		return output;
+	}
 
-	CTeleIO CModelExecutionAPI::Execute(const std::string& str_options, const CTeleIO& input)
+	//empty a stream and keep its buffer: the buffer is moved out and back in (C++20), so its capacity
+	//is reused by the next run. Assigning an empty string may free the buffer, depending on the library
+	static void ResetStream(std::stringstream& stream)
 	{
-		assert(m_pModel);
+		std::string buffer = std::move(stream).str();
+		buffer.clear();
+		stream.str(std::move(buffer));
+		stream.clear();
+	}
 
+	CTeleIO CModelExecutionAPI::ExecuteWeather(const CModelExecutionOptions& options, const CSimulationPointVector& simulationPoints, CPhaseTimer& timer)const
+	{
 		CTeleIO output;
+		ERMsg msg;
+		CCallback callback;
 
-		if (m_pModel.get() == nullptr)
+		//simulationPoints.GetVariables() == ;
+
+		//one model input by parameters set of the sweep
+		vector<string> parameterSets = options.GetParameterSets();
+		vector<CModelInput> modelInputs(parameterSets.size());
+		for (size_t p = 0; p < parameterSets.size(); p++)
+			msg += CModelExecutionOptions::GetModelInput(*m_pModel, parameterSets[p], modelInputs[p]);
+
+		CParameterVector pOut = m_pModel->GetOutputDefinition().GetParametersVector();
+		string header;
+		vector<string> variables;
+		for (size_t i = 0; i < pOut.size(); i++)
 		{
-			output.m_msg = "Model is not define yet. Call Initialize first";
-			return output;
+			header += (i == 0 ? "" : ",") + pOut[i].m_name;
+			variables.push_back(pOut[i].m_name);
 		}
+		//load files in memory for stream transfer
+//		stringstream staticDataStream;
+		//msg = LoadStaticData(fileManager, model, modelInputVector.m_pioneer, staticDataStream);
+		//if (msg)
+		//	msg = model.SetStaticData(staticDataStream);
 
+//		staticDataStream.clear();//clear any bits set
+	//	staticDataStream.str(std::string());
 
+		//if (!msg)
+			//return msg;
 
-		ERMsg msg;
-		CCallback callback;
-
-		CModelExecutionOptions options;
-		msg += options.parse(str_options);
 		if (msg)
 		{
+			assert(!simulationPoints.empty());
+			//verify nb years and variables
 
-			CSimulationPointVector simulationPoints;
-			msg += LoadWeather(input, simulationPoints);
-
+			if (simulationPoints.begin()->GetNbYears() < m_pModel->GetNbYearMin() || simulationPoints.begin()->GetNbYears() > m_pModel->GetNbYearMax())
+				msg.ajoute(FormatMsg("The number of year(s) (%1%) defined in the WG Input is invalid for this model. The model \"%2%\" needs at least %3% year(s) and not more than %4% year(s).", to_string(simulationPoints.begin()->GetNbYears()), m_pModel->GetName(), to_string(m_pModel->GetNbYearMin()), to_string(m_pModel->GetNbYearMax())));
 
-			//simulationPoints.GetVariables() == ;
+			msg += m_pModel->VerifyInputs(simulationPoints.begin()->GetSSIHeader(), simulationPoints.GetVariables());
+		}
 
-			CModelInput modelInput;
-			msg += options.GetModelInput(*m_pModel, modelInput);
-			CParameterVector pOut = m_pModel->GetOutputDefinition().GetParametersVector();
-			string header;
-			for (size_t i = 0; i < pOut.size(); i++)
-				header += (i == 0 ? "" : ",") + pOut[i].m_name;
-			//load files in memory for stream transfer
-	//		stringstream staticDataStream;
-			//msg = LoadStaticData(fileManager, model, modelInputVector.m_pioneer, staticDataStream);
-			//if (msg)
-			//	msg = model.SetStaticData(staticDataStream);
+		if (msg)
+		{
 
-	//		staticDataStream.clear();//clear any bits set
-		//	staticDataStream.str(std::string());
 
-			//if (!msg)
-				//return msg;
+			// Compress
+			std::stringstream stream;
+			//CStatistic::SetVMiss(-999);
 
-			if (msg)
+			boost::iostreams::filtering_streambuf<boost::iostreams::input> out;
+			if (options.m_compress)
 			{
-				assert(!simulationPoints.empty());
-				//verify nb years and variables
-
-				if (simulationPoints.begin()->GetNbYears() < m_pModel->GetNbYearMin() || simulationPoints.begin()->GetNbYears() > m_pModel->GetNbYearMax())
-					msg.ajoute(FormatMsg("The number of year(s) (%1%) defined in the WG Input is invalid for this model. The model \"%2%\" needs at least %3% year(s) and not more than %4% year(s).", to_string(simulationPoints.begin()->GetNbYears()), m_pModel->GetName(), to_string(m_pModel->GetNbYearMin()), to_string(m_pModel->GetNbYearMax())));
-
-				msg += m_pModel->VerifyInputs(simulationPoints.begin()->GetSSIHeader(), simulationPoints.GetVariables());
+				boost::iostreams::gzip_params p;
+				p.file_name = "data.csv";
+				out.push(boost::iostreams::gzip_compressor(p));
 			}
+			out.push(stream);
 
-			if (msg)
-			{
+			size_t m_seedType = 0; // RANDOM_FOR_ALL
+			size_t nb_sets = modelInputs.size();
+			size_t runs_by_set = simulationPoints.size() * options.m_replications;
+			size_t total_runs = nb_sets * runs_by_set;
+			size_t total_seeds = (m_seedType < 2) ? runs_by_set : options.m_replications;//same seeds for all parameters sets
 
+			CRandomGenerator rand(options.m_seed);//0 for random seed else fixed seed
+			vector<unsigned long> seeds;
+			for (size_t i = 0; i < total_seeds; i++)
+				seeds.push_back(1 + rand.Rand());
 
-				// Compress
-				std::stringstream stream;
-				//CStatistic::SetVMiss(-999);
 
-				boost::iostreams::filtering_streambuf<boost::iostreams::input> out;
-				if (options.m_compress)
-				{
-					boost::iostreams::gzip_params p;
-					p.file_name = "data.csv";
-					out.push(boost::iostreams::gzip_compressor(p));
-				}
-				out.push(stream);
 
-				size_t m_seedType = 0; // RANDOM_FOR_ALL
-				size_t total_runs = simulationPoints.size() * options.m_replications;
-				size_t total_seeds = (m_seedType < 2) ? total_runs : options.m_replications;
+			//runs are independent: they are executed in parallel and their results 
+			//are saved in the same order as the serial loop (parameters set, simulation point, replication)
+			vector<ERMsg> messages(total_runs);
+			vector<string> results(total_runs);
 
-				CRandomGenerator rand(m_seedType % 2 ? CRandomGenerator::FIXE_SEED : CRandomGenerator::RANDOM_SEED);
-				vector<unsigned long> seeds;
-				for (size_t i = 0; i < total_seeds; i++)
-					seeds.push_back(1 + rand.Rand());
+			//transfer streams are created once by thread and reset between runs, keeping their buffers
+			vector<stringstream> inStreams(GetNbCPU());
+			vector<stringstream> outStreams(GetNbCPU());
 
+			//statistics over replications instead of all results: results are added in the order of the runs 
+			//as soon as they are completed, so only the results of runs completed out of order are kept
+			bool bStatistics = !options.m_statistics.empty();
+			vector<CReplicationStatistics> statistics(bStatistics ? nb_sets : 0, CReplicationStatistics(options.m_statistics));
+			std::mutex statistics_mutex;
+			std::map<size_t, std::shared_ptr<CModelStatVector>> completed;
+			size_t next_run = 0;
 
+			timer.start("Execution");
+#pragma omp parallel for schedule(dynamic, 1) num_threads(GetNbCPU()) if (total_runs > 1)
+			for (int i = 0; i < (int)total_runs; i++)
+			{
+				size_t p = size_t(i) / runs_by_set;
+				size_t s = (size_t(i) % runs_by_set) / options.m_replications;
+				size_t r = size_t(i) % options.m_replications;
+				std::shared_ptr<CModelStatVector> pResult;
 
-				for (size_t s = 0; s < simulationPoints.size() && msg; s++)
+				try
 				{
 					//write info and weather to the stream
 					const CSimulationPoint& simulationPoint = simulationPoints[s];
 					assert(!simulationPoint.empty());
 
-					for (size_t r = 0; r < options.m_replications && msg; r++)
+					CThreadCPUTimer run_timer;
+
+					stringstream& inStream = inStreams[omp_get_thread_num()];
+					stringstream& outStream = outStreams[omp_get_thread_num()];
+					ResetStream(inStream);
+					ResetStream(outStream);
+
+					//get transfer info
+					size_t seed_pos = m_seedType < 2 ? s * options.m_replications + r : r;
+					CTransferInfoIn info;
+					FillTransferInfo(*m_pModel, simulationPoint, modelInputs[p], seeds[seed_pos], p, nb_sets, s * options.m_replications + r, runs_by_set, info);
+
+					CCommunicationStream::WriteInputStream(info, simulationPoint, inStream);
+					timer.add("Transfer", run_timer.elapsed());
+
+					run_timer.start();
 					{
-						stringstream inStream;
-						stringstream outStream;
+						//models are not re-entrant unless declared thread-safe
+						std::unique_lock<std::mutex> lock(*m_pModelMutex, std::defer_lock);
+						if (!m_bThreadSafe)
+							lock.lock();
 
-						//get transfer info
-						size_t seed_pos = m_seedType < 2 ? s * options.m_replications + r : r;
-						CTransferInfoIn info;
-						FillTransferInfo(*m_pModel, simulationPoint, modelInput, seeds[seed_pos], s * options.m_replications + r, options.m_replications * simulationPoints.size(), info);
-						CCommunicationStream::WriteInputStream(info, simulationPoint, inStream);
+						messages[i] += m_pModel->RunModel(inStream, outStream);	// call DLL
+					}
+					timer.add("Model", run_timer.elapsed());
 
-						msg += m_pModel->RunModel(inStream, outStream);	// call DLL
-						if (msg)
+					if (messages[i])
+					{
+						//get output from stream
+						run_timer.start();
+						CTransferInfoOut infoOut;
+						CModelStatVector result;
+						messages[i] += CCommunicationStream::ReadOutputStream(outStream, infoOut, result);
+						timer.add("Transfer", run_timer.elapsed());
+						//section.SetMissing(model.GetMissValue());
+						if (messages[i] && bStatistics)
 						{
-							//get output from stream
-							CTransferInfoOut infoOut;
-							CModelStatVector result;
-							msg += CCommunicationStream::ReadOutputStream(outStream, infoOut, result);
-							//section.SetMissing(model.GetMissValue());
-							if (msg)
-							{
-								result.SetHeader(header);
-								result.Save(stream);
-								//msg.ajoute(FormatMsg(IDS_SIM_SIMULATION_ERROR, to_string(1), location.m_name, location.m_ID));
-							}
+							pResult = make_shared<CModelStatVector>(std::move(result));
+						}
+						else if (messages[i])
+						{
+							run_timer.start();
+							stringstream resultStream;
+							result.SetHeader(header);
+							result.Save(resultStream);
+							results[i] = resultStream.str();
+							timer.add("Serialization", run_timer.elapsed());
+						}
+
+					}// if (msg)
+				}
+				catch (...)
+				{
+					messages[i].ajoute("Unexpected error for parameters set " + to_string(p + 1) + ", simulation point " + to_string(s + 1) + ", replication " + to_string(r + 1));
+				}
 
-						}// if (msg)
-					}//for all model replications
-				}//for all weather replications
+				if (bStatistics)
+				{
+					CThreadCPUTimer stat_timer;
 
+					std::lock_guard<std::mutex> lock(statistics_mutex);
+					completed[i] = pResult;
 
+					//add all results completed in order
+					auto it = completed.find(next_run);
+					while (it != completed.end())
+					{
+						if (it->second)
+							messages[next_run] += statistics[next_run / runs_by_set].add(*it->second);
 
+						completed.erase(it);
+						it = completed.find(++next_run);
+					}
 
-				std::stringstream compressed;
-				boost::iostreams::copy(out, compressed);
+					timer.add("Statistics", stat_timer.elapsed());
+				}
+			}//for all runs
+			timer.stop();
 
-				//zen::XmlElement root("Metadata");
-				//zen::writeStruc(modelInput, root.addChild(CModelInput::GetXMLFlag()));
-				//pugi::xml_document doc;
-				//pugi::xml_node root = doc.append_child("Metadata");
-				string json_str;
-				output.m_metadata = json_str;
+			if (bStatistics)
+			{
+				for (size_t p = 0; p < nb_sets; p++)
+				{
+					std::stringstream summary;
+					statistics[p].save(summary, variables);
 
+					//statistics of a parameters set take the place of the first run results
+					results[p * runs_by_set] = summary.str();
+				}
+			}
 
-				output.m_compress = options.m_compress;
-				//if (options.m_compress)
-				output.m_data = compressed.str();
-				//else
-					//output.m_text = compressed.str();
+			//offset and size (uncompressed) of each parameters set of a sweep
+			nlohmann::json sections = nlohmann::json::array();
+			size_t offset = 0;
+			for (size_t p = 0; p < nb_sets && msg; p++)
+			{
+				size_t size = 0;
+				for (size_t i = p * runs_by_set; i < (p + 1) * runs_by_set && msg; i++)
+				{
+					msg += messages[i];
+					stream << results[i];
+					size += results[i].size();
+				}
 
+				sections.push_back({ {"Parameters", parameterSets[p]}, {"Offset", offset}, {"Size", size} });
+				offset += size;
 			}
+
+
+
+
+			timer.start("Compression");
+			std::stringstream compressed;
+			boost::iostreams::copy(out, compressed);
+			timer.stop();
+
+			//zen::XmlElement root("Metadata");
+			//zen::writeStruc(modelInput, root.addChild(CModelInput::GetXMLFlag()));
+			//pugi::xml_document doc;
+			//pugi::xml_node root = doc.append_child("Metadata");
+			string json_str;
+			if (nb_sets > 1)
+				json_str = nlohmann::json({ {"ParameterSets", sections} }).dump();
+
+			output.m_metadata = json_str;
+
+
+			output.m_compress = options.m_compress;
+			//if (options.m_compress)
+			output.m_data = compressed.str();
+			//else
+				//output.m_text = compressed.str();
+
 		}
 
 		output.m_msg = get_string(msg);
 		output.m_comment = ANSI_UTF8(callback.GetMessages());
+		SetTiming(output, timer);
 
 		return output;
 	}
 
 
-	void CModelExecutionAPI::FillTransferInfo(const CModel& model, const CLocation& locations, const CModelInput& modelInput, size_t seed, size_t r, size_t n_r, CTransferInfoIn& info)
+	void CModelExecutionAPI::FillTransferInfo(const CModel& model, const CLocation& locations, const CModelInput& modelInput, size_t seed, size_t p, size_t n_p, size_t r, size_t n_r, CTransferInfoIn& info)
 	{
 		assert(model.GetTransferFileVersion() == CModel::VERSION_STREAM);
 
@@ -1191,7 +3465,7 @@ namespace WBSF
 		info.m_modelName = model.GetName();
 
 		info.m_locCounter = CCounter(0, 1);
-		info.m_paramCounter = CCounter(0, 1);
+		info.m_paramCounter = CCounter(p, n_p);
 		info.m_repCounter = CCounter(r, n_r);
 
 
@@ -1205,6 +3479,11 @@ namespace WBSF
 		//		return info;
 	}
 
+	size_t CModelExecutionAPI::GetNbLoadedModels()
+	{
+		return MODEL_REGISTRY.size();
+	}
+
 	std::string CModelExecutionAPI::GetWeatherVariablesNeeded()
 	{
 		assert(m_pModel);
@@ -1296,51 +3575,387 @@ namespace WBSF
 		return msg;
 	}
 
-	ERMsg LoadWeather(const CTeleIO& IO, CSimulationPointVector& simulationPoints)
+	//parse the data lines of one replication directly into the simulation point
+	static ERMsg ParseWeatherBlock(std::string_view block, const vector<int>& columns, bool bHourly, CSimulationPoint& simulationPoint)
 	{
+		enum TColumn { C_YEAR = -1, C_MONTH = -2, C_DAY = -3, C_HOUR = -4 };
+
 		ERMsg msg;
 
-		CLocation location = GetLocation(IO.m_metadata);
-		//zen::from_string(loc, IO.m_metadata);
+		//skip header
+		const char* p = std::find(block.data(), block.data() + block.size(), '\n');
+		const char* end = block.data() + block.size();
+		if (p != end)
+			p++;
+
+		//first and last years, from the first and the last lines
+		const char* last = end;
+		while (last > p && (last[-1] == '\n' || last[-1] == '\r'))
+			last--;
+
+		const char* last_line = last;
+		while (last_line > p && last_line[-1] != '\n')
+			last_line--;
+
+		int first_year = 0;
+		int last_year = 0;
+		std::from_chars(p, end, first_year);
+		std::from_chars(last_line, last, last_year);
+		if (first_year <= 0 || last_year < first_year)
+		{
+			msg.ajoute("Invalid years in weather data");
+			return msg;
+		}
+
+		simulationPoint.SetHourly(bHourly);
+		simulationPoint.CreateYears(first_year, size_t(last_year - first_year + 1));
+		CTM TM(bHourly ? CTM::HOURLY : CTM::DAILY);
 
-		try
+		vector<double> values(columns.size());
+		while (p < end && msg)
 		{
-			boost::iostreams::filtering_istreambuf in;
-			if (IO.m_compress)
-				in.push(boost::iostreams::gzip_decompressor());
+			const char* eol = std::find(p, end, '\n');
+			const char* line_end = (eol > p && eol[-1] == '\r') ? eol - 1 : eol;
+
+			if (line_end > p)
+			{
+				const char* q = p;
+				for (size_t c = 0; c < columns.size() && msg; c++)
+				{
+					while (q < line_end && *q == ' ')
+						q++;
+
+					auto result = std::from_chars(q, line_end, values[c]);
+					if (result.ec != std::errc())
+					{
+						msg.ajoute("Invalid weather value: " + string(p, line_end));
+						break;
+					}
+
+					q = result.ptr;
+					while (q < line_end && *q == ' ')
+						q++;
+					if (q < line_end && *q == ',')
+						q++;
+				}
+
+				int year = 0;
+				int month = 1, day = 1, hour = 0;
+				if (msg)
+				{
+					for (size_t c = 0; c < columns.size(); c++)
+					{
+						switch (columns[c])
+						{
+						case C_YEAR: year = int(values[c]); break;
+						case C_MONTH: month = int(values[c]); break;
+						case C_DAY: day = int(values[c]); break;
+						case C_HOUR: hour = int(values[c]); break;
+						default: break;
+						}
+					}
+
+					//years must be in the period of the first and the last lines
+					if (year < first_year || year > last_year || month < 1 || month > 12 || day < 1 || day > int(GetNbDayPerMonth(year, size_t(month - 1))) || hour < 0 || hour > 23)
+						msg.ajoute("Invalid date in weather data: " + string(p, line_end));
+				}
+
+				if (msg)
+				{
+					CTRef TRef(year, size_t(month - 1), size_t(day - 1), size_t(hour), TM);
+					for (size_t c = 0; c < columns.size(); c++)
+					{
+						if (columns[c] >= 0 && values[c] > -999)
+							simulationPoint[TRef].SetStat(TVarH(columns[c]), CStatistic(values[c]));
+					}
+				}
+			}
+
+			p = (eol == end) ? end : eol + 1;
+		}
+
+		return msg;
+	}
+
+	//split the data in replications, each beginning with the same header line
+	static bool SplitWeatherCSV(std::string_view data, std::string_view& header, vector<std::string_view>& blocks)
+	{
+		size_t pos = data.find_first_not_of("\r\n");
+		while (pos != std::string_view::npos)
+		{
+			if (data.compare(pos, 4, "Year") != 0)
+				return false;
+
+			size_t next = data.find("\nYear", pos);
+			blocks.push_back(data.substr(pos, next == std::string_view::npos ? std::string_view::npos : next + 1 - pos));
+			pos = next == std::string_view::npos ? next : next + 1;
+		}
+
+		if (blocks.empty())
+			return true;
+
+		//all replications must have the same header
+		header = blocks[0].substr(0, blocks[0].find('\n'));
+		if (!header.empty() && header.back() == '\r')
+			header.remove_suffix(1);
+
+		for (size_t b = 1; b < blocks.size(); b++)
+		{
+			if (blocks[b].compare(0, header.size(), header) != 0)
+				return false;
+		}
+
+		return true;
+	}
+
+	//columns of the header: only time columns (Year, Month, Day, Hour) and known variables are supported
+	static bool GetWeatherCSVColumns(std::string_view header, vector<int>& columns, bool& bHourly)
+	{
+		enum TColumn { C_YEAR = -1, C_MONTH = -2, C_DAY = -3, C_HOUR = -4 };
+
+		columns.clear();
+		bHourly = false;
+		vector<string> fields = Tokenize(string(header), ",");
+		for (size_t c = 0; c < fields.size(); c++)
+		{
+			string field = Trim(fields[c]);
+			if (boost::iequals(field, "Year"))
+				columns.push_back(C_YEAR);
+			else if (boost::iequals(field, "Month"))
+				columns.push_back(C_MONTH);
+			else if (boost::iequals(field, "Day"))
+				columns.push_back(C_DAY);
+			else if (boost::iequals(field, "Hour"))
+			{
+				columns.push_back(C_HOUR);
+				bHourly = true;
+			}
+			else
+			{
+				TVarH v = GetVariableFromName(field);
+				if (v == H_SKIP)
+					return false;
+
+				columns.push_back(int(v));
+			}
+		}
+
+		return std::find(columns.begin(), columns.end(), C_MONTH) != columns.end() && std::find(columns.begin(), columns.end(), C_DAY) != columns.end();
+	}
+
+	//parse replications in parallel, added at the end of the simulation points
+	static void ParseWeatherBlocks(const vector<std::string_view>& blocks, const vector<int>& columns, bool bHourly, const CLocation& location, CSimulationPointVector& simulationPoints, ERMsg& msg)
+	{
+		size_t first = simulationPoints.size();
+		simulationPoints.resize(first + blocks.size());
+		vector<ERMsg> messages(blocks.size());
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(GetNbCPU()) if (blocks.size() > 1)
+		for (int b = 0; b < (int)blocks.size(); b++)
+		{
+			size_t r = first + b;
+			try
+			{
+				((CLocation&)simulationPoints[r]) = location;
+				simulationPoints[r].m_ID = to_string(r + 1);
+				simulationPoints[r].m_name = "Replication" + to_string(r + 1);
+				messages[b] = ParseWeatherBlock(blocks[b], columns, bHourly, simulationPoints[r]);
+			}
+			catch (...)
+			{
+				messages[b].ajoute("Unexpected error for replication " + to_string(r + 1));
+			}
+		}
+
+		for (size_t b = 0; b < messages.size(); b++)
+			msg += messages[b];
+	}
 
-			std::string s = IO.m_data;
-			stringstream stream(s);
-			in.push(stream);
+	//Single pass CSV weather parser: numbers are parsed in place, without copy of lines, 
+	//and replications are parsed in parallel. Only time columns (Year, Month, Day, Hour) and 
+	//known variables are supported: return false for other headers, the generic parser is then used.
+	static bool ParseWeatherCSV(std::string_view data, const CLocation& location, CSimulationPointVector& simulationPoints, ERMsg& msg)
+	{
+		std::string_view header;
+		vector<std::string_view> blocks;
+		if (!SplitWeatherCSV(data, header, blocks) || blocks.empty())
+			return false;
+
+		vector<int> columns;
+		bool bHourly = false;
+		if (!GetWeatherCSVColumns(header, columns, bHourly))
+			return false;
+
+		simulationPoints.clear();
+		ParseWeatherBlocks(blocks, columns, bHourly, location, simulationPoints, msg);
+
+		return true;
+	}
+
+	//size of the decompressed chunks read from compressed weather
+	static const size_t WEATHER_CHUNK_SIZE = 64 * 1024;
+
+	//append the next chunk of the stream to the buffer, return the number of characters read (0 at the end)
+	static size_t ReadWeatherChunk(std::streambuf& in, std::string& buffer)
+	{
+		size_t size = buffer.size();
+		buffer.resize(size + WEATHER_CHUNK_SIZE);
+		size_t nb_read = size_t(std::max(std::streamsize(0), in.sgetn(buffer.data() + size, std::streamsize(WEATHER_CHUNK_SIZE))));
+		buffer.resize(size + nb_read);
 
-			std::istream incoming(&in);
+		return nb_read;
+	}
+
+	//Same parser on a decompression stream: the data is read in fixed-size chunks and the complete 
+	//replications of the buffer are parsed as soon as the next header is read. The partial replication 
+	//(and its partial last line) is carried over to the next chunk, so the memory is bounded by the 
+	//chunk and replication sizes instead of the decompressed size. The buffer holds the first chunk.
+	static bool ParseWeatherCSV(std::streambuf& in, std::string& buffer, const CLocation& location, CSimulationPointVector& simulationPoints, ERMsg& msg)
+	{
+		string header;
+		vector<int> columns;
+		bool bHourly = false;
+		ERMsg parse_msg;
+
+		simulationPoints.clear();
 
-			vector<string> replications;
-			string line;
-			while (std::getline(incoming, line) && msg)
+		size_t search_from = 0;
+		for (bool bEOF = false; ; bEOF = ReadWeatherChunk(in, buffer) == 0)
+		{
+			//complete replications: up to the last header line, or all the remaining data at the end
+			size_t end = 0;
+			if (bEOF)
+				end = buffer.size();
+			else
+				for (size_t pos = buffer.find("\nYear", search_from); pos != string::npos; pos = buffer.find("\nYear", pos + 1))
+					end = pos + 1;
+
+			if (end > 0)
 			{
-				if (!line.empty())
+				std::string_view block_header;
+				vector<std::string_view> blocks;
+				if (!SplitWeatherCSV(std::string_view(buffer.data(), end), block_header, blocks))
+					return false;
+
+				if (!blocks.empty())
 				{
-					bool bNewReplication = WBSF::Find(line.substr(0, 4), "Year") != string::npos;
-					if (bNewReplication)
+					if (header.empty())
 					{
-						replications.push_back(line + "\r\n");
+						header = block_header;
+						if (!GetWeatherCSVColumns(header, columns, bHourly))
+							return false;
 					}
-					else
+					else if (block_header != header)
 					{
-						replications.back() += line + "\r\n";
-					}//good number of column
-				}//line not empty
-			}//for all lines
+						return false;
+					}
+
+					ParseWeatherBlocks(blocks, columns, bHourly, location, simulationPoints, parse_msg);
+				}
+
+				buffer.erase(0, end);
+			}
+
+			if (bEOF)
+				break;
+
+			//a header can begin at the end of this chunk
+			search_from = buffer.size() > 4 ? buffer.size() - 4 : 0;
+		}
+
+		if (simulationPoints.empty())
+			return false;
+
+		msg += parse_msg;
+		return true;
+	}
+
+	//generic parser: any column supported by CWeatherYears
+	static void ParseWeatherGeneric(std::istream& incoming, const CLocation& location, CSimulationPointVector& simulationPoints, ERMsg& msg)
+	{
+		simulationPoints.clear();
+
+		vector<string> replications;
+		string line;
+		while (std::getline(incoming, line) && msg)
+		{
+			if (!line.empty())
+			{
+				bool bNewReplication = WBSF::Find(line.substr(0, 4), "Year") != string::npos;
+				if (bNewReplication)
+				{
+					replications.push_back(line + "\r\n");
+				}
+				else if (!replications.empty())
+				{
+					replications.back() += line + "\r\n";
+				}//good number of column
+			}//line not empty
+		}//for all lines
+
+
+		simulationPoints.resize(replications.size());
+		for (size_t i = 0; i < replications.size(); i++)
+		{
+			((CLocation&)simulationPoints[i]) = location;
+			simulationPoints[i].m_ID = to_string(i + 1);
+			simulationPoints[i].m_name = "Replication" + to_string(i + 1);
+			simulationPoints[i].Parse(replications[i]);
+		}
+	}
+
+	ERMsg LoadWeather(const CTeleIOView& IO, CSimulationPointVector& simulationPoints)
+	{
+		ERMsg msg;
+
+		try
+		{
+			CLocation location = GetLocation(IO.m_metadata);
+			//zen::from_string(loc, IO.m_metadata);
+
+			if (IO.m_compress)
+			{
+				//decompress by chunks, directly from the input data, without copy of the compressed data
+				boost::iostreams::filtering_istreambuf in;
+				in.push(boost::iostreams::gzip_decompressor());
+				in.push(boost::iostreams::array_source(IO.m_data.data(), IO.m_data.size()));
+
+				std::string buffer;
+				ReadWeatherChunk(in, buffer);
 
+				//binary columnar format: need all the data
+				if (IsBinaryWeather(buffer))
+				{
+					while (ReadWeatherChunk(in, buffer) > 0);
+					return LoadBinaryWeather(buffer, simulationPoints);
+				}
 
-			simulationPoints.resize(replications.size());
-			for (size_t i = 0; i < replications.size(); i++)
+				if (!ParseWeatherCSV(in, buffer, location, simulationPoints, msg))
+				{
+					//generic parser: decompress again from the beginning
+					buffer = std::string();
+					boost::iostreams::filtering_istreambuf in_generic;
+					in_generic.push(boost::iostreams::gzip_decompressor());
+					in_generic.push(boost::iostreams::array_source(IO.m_data.data(), IO.m_data.size()));
+
+					std::istream incoming(&in_generic);
+					ParseWeatherGeneric(incoming, location, simulationPoints, msg);
+				}
+			}
+			else
 			{
-				((CLocation&)simulationPoints[i]) = location;
-				simulationPoints[i].m_ID = to_string(i + 1);
-				simulationPoints[i].m_name = "Replication" + to_string(i + 1);
-				simulationPoints[i].Parse(replications[i]);
+				std::string_view data(IO.m_data);
+
+				//binary columnar format
+				if (IsBinaryWeather(data))
+					return LoadBinaryWeather(data, simulationPoints);
+
+				if (!ParseWeatherCSV(data, location, simulationPoints, msg))
+				{
+					//generic parser, read directly from the input data
+					boost::iostreams::stream<boost::iostreams::array_source> incoming(IO.m_data.data(), IO.m_data.size());
+					ParseWeatherGeneric(incoming, location, simulationPoints, msg);
+				}
 			}
 
 		}//try
@@ -1353,6 +3968,11 @@ namespace WBSF
 				msg.ajoute(exception.what());
 			}
 		}
+		catch (const std::exception& e)
+		{
+			//nothing must cross the DLL boundary
+			msg.ajoute(e.what());
+		}
 
 		return msg;
 	}
@@ -1,7 +1,11 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <memory>
+#include <mutex>
+#include <functional>
+#include <vector>
 #include "Basic/ERMsg.h"
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -25,6 +29,7 @@ namespace WBSF
 {
 
 	class CGDALDatasetEx;
+	class CCallback;
 	class CWeatherGenerator;
 	class CNormalsDatabase;
 	class CDailyDatabase;
@@ -36,6 +41,10 @@ namespace WBSF
 	class CModelInput;
 	class CWeatherStationVector;
 	class CTransferInfoIn;
+	class CTeleIOCache;
+	class CSingleFlight;
+	class CPhaseTimer;
+	class CDailyDatabasePool;
 	typedef CWeatherStationVector CSimulationPointVector;
 
 
@@ -46,13 +55,16 @@ namespace WBSF
 	typedef std::shared_ptr<CGDALDatasetEx> CGDALDatasetExPtr;
 	typedef std::shared_ptr<CWeatherGenerator> CWeatherGeneratorPtr;
 	typedef std::shared_ptr<CModel> CModelPtr;
+	typedef std::shared_ptr<CTeleIOCache> CTeleIOCachePtr;
+	typedef std::shared_ptr<CSingleFlight> CSingleFlightPtr;
+	typedef std::shared_ptr<CDailyDatabasePool> CDailyDatabasePoolPtr;
 
 
 	class CGlobalDLLData
 	{
 	public:
 
-		enum TParam { MODELS_PATH, SHORE, DEM, DAILY_CACHE_SIZE, NB_PAPAMS };
+		enum TParam { MODELS_PATH, SHORE, DEM, DAILY_CACHE_SIZE, NB_CPU, PRELOAD_MODELS, NB_PAPAMS };
 		static const char* NAME[NB_PAPAMS];
 
 
@@ -67,6 +79,8 @@ namespace WBSF
 		std::string m_shore_file_path;
 		std::string m_DEM_file_path;
 		size_t m_daily_cache_size;
+		int m_nb_CPU;//number of threads used by internal parallel loops. 0 = all CPU, negative = all CPU minus N
+		bool m_preload_models;//load all models of the models path at initialization
 
 	
 
@@ -87,16 +101,17 @@ namespace WBSF
 	{
 	public:
 
-		CTeleIO(bool compress = false, const std::string& msg = "", const std::string& comment = "", const std::string& metadata = "", const std::string& data = "")
+		CTeleIO(bool compress = false, std::string msg = "", std::string comment = "", std::string metadata = "", std::string data = "")
 		{
 
 			m_compress = compress;		//if output is compress or not
-			m_msg = msg;		//error message
-			m_comment = comment;	//comments
-			m_metadata = metadata;	//output metadata in XML
-			m_data = data;	//output data 
+			m_msg = std::move(msg);		//error message
+			m_comment = std::move(comment);	//comments
+			m_metadata = std::move(metadata);	//output metadata in XML
+			m_data = std::move(data);	//output data 
 		}
 
+		//timing is not part of the content: ignored
 		bool operator==(const CTeleIO& other) const
 		{
 			return m_compress == other.m_compress &&
@@ -109,18 +124,43 @@ namespace WBSF
 		bool m_compress;		//if output is compress or not
 		std::string m_msg;		//error message
 		std::string m_comment;	//comments
-		std::string m_metadata;	//output metadata in XML
+		std::string m_metadata;	//output metadata in JSON
 		std::string m_data;		//output data 
+		std::string m_timing;	//wall and CPU time of each phase of this call in JSON, CPU of the threads of parallel phases in ThreadCPU
 
 	};
 
+	//Non-owning view of an input (weather) given to the model: the data are not copied. 
+	//The viewed buffers must remain valid during the call.
+	class DLL_EXPORT CTeleIOView
+	{
+	public:
+
+		CTeleIOView(const CTeleIO& IO) :
+			m_compress(IO.m_compress),
+			m_metadata(IO.m_metadata),
+			m_data(IO.m_data)
+		{}
+
+		CTeleIOView(bool compress, std::string_view metadata, const char* data, size_t size) :
+			m_compress(compress),
+			m_metadata(metadata),
+			m_data(data, size)
+		{}
+
+		bool m_compress;				//if data is compress or not
+		std::string_view m_metadata;	//input metadata in JSON
+		std::string_view m_data;		//input data
+	};
+
 
 	class CWeatherGeneratorInit
 	{
 
 	public:
 		
-		enum TParam { NORMALS, DAILY, HOURLY, GRIBS, NB_PAPAMS };
+		enum TParam { NORMALS, DAILY, HOURLY, GRIBS, CACHE_SIZE, NB_CPU, NB_PAPAMS };
+		enum { GLOBAL_NB_CPU = -999 };
 		static const char* NAME[NB_PAPAMS];
 
 		CWeatherGeneratorInit();
@@ -129,6 +169,8 @@ namespace WBSF
 
 		std::string m_normal_name;
 		std::string m_daily_name;
+		size_t m_cache_size;//maximum size of the result cache in MB. 0 = no cache
+		int m_nb_CPU;//number of threads of this instance, same meaning as global NbCPU. GLOBAL_NB_CPU = global NbCPU
 
 	};
 
@@ -139,12 +181,13 @@ namespace WBSF
 	{
 	public:
 
-		enum TParam { VARIABLES, SOURCE_TYPE, GENERATION_TYPE, REPLICATIONS, KEY_ID, NAME, LATITUDE, LONGITUDE, ELEVATION, SLOPE, ORIENTATION, NB_NEAREST_NEIGHBOR, FIRST_YEAR, LAST_YEAR, NB_YEARS, SEED, NORMALS_INFO, COMPRESS, NB_PAPAMS };
+		enum TParam { VARIABLES, SOURCE_TYPE, GENERATION_TYPE, REPLICATIONS, KEY_ID, NAME, LATITUDE, LONGITUDE, ELEVATION, SLOPE, ORIENTATION, NB_NEAREST_NEIGHBOR, FIRST_YEAR, LAST_YEAR, NB_YEARS, SEED, NORMALS_INFO, COMPRESS, FORMAT, NB_PAPAMS };
 		static const char* PARAM_NAME[NB_PAPAMS];
 
 		CWeatherGeneratorOptions();
 		ERMsg parse(const std::string& options);
 		void GetWGInput(CWGInput& WGInput)const;
+		std::string GetCanonical()const;
 
 		std::string m_variables;
 		int m_sourceType; //from normal=0, from observation=1
@@ -164,11 +207,19 @@ namespace WBSF
 		int m_last_year;
 		int m_seed;//0 for random seed else fixed seed 
 		bool m_compress;
+		int m_format;//CSV=0, binary columnar=1
 	};
 
 
 	
 
+	//Once initialized, Generate and GetNormals can be called concurrently from many threads:
+	//databases are shared read-only and each call use its own weather generator.
+	//Identical concurrent calls to Generate with a fixed seed are generated only once.
+	//Instances opening the same database files share one loaded copy. Daily databases read 
+	//from disk (.DailyDB) are not shared: each generator in use has its own opened instance.
+	//Reload refresh the daily database without blocking calls in progress.
+	//Initialize must not be called while other calls are in progress.
 	class DLL_EXPORT CWeatherGeneratorAPI
 	{
 
@@ -179,10 +230,18 @@ namespace WBSF
 
 		CWeatherGeneratorAPI(const std::string &);
 		std::string Initialize(const std::string& str_options);
+		std::string Reload();
 		CTeleIO Generate(const std::string& str_options);
+		CTeleIO GenerateBatch(const std::string& str_options, const std::string& str_locations);
+		CTeleIO GenerateStream(const std::string& str_options, const std::function<void(const std::string& chunk)>& sink);
 		//CTeleIO GenerateGribs(const std::string& str_options);
 		CTeleIO GetNormals(const std::string& str_options);
 
+		size_t GetCacheHits()const;
+		size_t GetCacheMisses()const;
+		//number of databases loaded in the process, shared by all instances
+		static size_t GetNbLoadedDatabases();
+
 		//void TestThreads(const std::string& str_options);
 
 	protected:
@@ -190,17 +249,32 @@ namespace WBSF
 		CWeatherGeneratorInit m_init;
 
 		CNormalsDatabasePtr m_pNormalDB;
-		CDailyDatabasePtr m_pDailyDB;
+		CDailyDatabasePtr m_pDailyDB;//database in memory, swapped by Reload
+		CDailyDatabasePoolPtr m_pDailyDBPool;//database read from disk: one instance per generator, swapped by Reload
+		std::string m_DB_key;//identity of the databases in use
+		mutable std::mutex m_DB_mutex;//to protect daily database snapshot swap
+		std::mutex m_reload_mutex;//one reload at a time
 		//CHourlyDatabasePtr m_pHourlyDB;
 		//CSfcGribExtractorPtr m_pGribsDB;
 		//CSfcGribDatabasePtr m_pGribsDB;
 		//CGDALDatasetExPtr m_pDEM;
 
-		CWeatherGeneratorPtr m_pWeatherGenerator;
-		
+		//results of deterministic (fixed seed) requests
+		CTeleIOCachePtr m_pCache;
+		//identical deterministic requests in progress
+		CSingleFlightPtr m_pSingleFlight;
+
+
+		ERMsg CreateWeatherGenerator(CWeatherGeneratorPtr& pWG)const;
+		int GetNbCPU()const;
+		std::string GetCacheKey(const CWeatherGeneratorOptions& options)const;
+		CTeleIO GenerateOutput(CWeatherGeneratorOptions options, CPhaseTimer& timer)const;
+		ERMsg GenerateSimulationPoints(CWeatherGeneratorOptions options, CSimulationPointVector& simulationPoints, CCallback& callback, CPhaseTimer& timer)const;
+		ERMsg GenerateWeather(const CWeatherGeneratorOptions& options, const CLocation& location, unsigned long seed, std::ostream& out, CCallback& callback, CPhaseTimer& timer, CSimulationPointVector* pSimulationPoints = nullptr)const;
+		static ERMsg ComputeElevation(double latitude, double longitude, double& elevation);
+		static void SaveNormals(std::ostream& out, const CNormalsStation& normals);
 
-		ERMsg ComputeElevation(double latitude, double longitude, double& elevation);
-		void SaveNormals(std::ostream& out, const CNormalsStation& normals);
+		friend class CModelExecutionAPI;
 	};
 
 
@@ -213,49 +287,71 @@ namespace WBSF
 	{
 	public:
 
-		enum TParam { PARAMETERS, REPLICATIONS, SEED, COMPRESS, NB_PAPAMS };
+		enum TParam { PARAMETERS, REPLICATIONS, SEED, COMPRESS, STATISTICS, NB_PAPAMS };
 		static const char* PARAM_NAME[NB_PAPAMS];
 
 		CModelExecutionOptions();
 		ERMsg parse(const std::string& options);
 		ERMsg GetModelInput(const CModel& model, CModelInput& modelInput)const;
+		static ERMsg GetModelInput(const CModel& model, const std::string& parameters, CModelInput& modelInput);
+		std::vector<std::string> GetParameterSets()const;
+		std::string GetCanonical()const;
 
-		std::string m_parameters; //input param [space format]
+		std::string m_parameters; //input param [space format]. Sweep: sets separated by ";", grid values separated by "|", "\" escapes them in values
 
 		size_t m_replications;
 		int m_seed;//0 for random seed else fixed seed 
 		bool m_compress;
+		std::vector<std::string> m_statistics;//statistics over replications (MEAN, SD, MIN, MAX, Qxx) instead of all replications
 	};
 
 
 	
 
+	//Identical concurrent calls to Execute with a fixed seed are computed only once.
+	//Models are loaded once per process and shared by all instances.
+	//With CacheSize (MB), results of calls with a fixed seed are kept and returned without running the model.
+	//Model DLLs are not assumed re-entrant: calls to a model are serialized over all instances,
+	//unless the model is declared thread-safe with ThreadSafe=1.
 	class DLL_EXPORT CModelExecutionAPI
 	{
 
 	public:
 
-		enum TParam { MODEL, NB_PAPAMS };
+		enum TParam { MODEL, CACHE_SIZE, THREAD_SAFE, NB_PAPAMS };
 		static const std::array<const char*, NB_PAPAMS> PARAM_NAME;
 
 		CModelExecutionAPI(const std::string &);
 		std::string Initialize(const std::string& str_options);
 		CTeleIO Execute(const std::string& str_options, const CTeleIO& input);
+		CTeleIO Execute(const std::string& str_options, const CTeleIOView& input);
+		CTeleIO Execute(const std::string& str_options, const CWeatherGeneratorAPI& weatherGen, const std::string& WG_options);
+		static CTeleIO ExecuteModels(const std::vector<const CModelExecutionAPI*>& models, const std::vector<std::string>& str_options, const CTeleIOView& input);
 		std::string GetWeatherVariablesNeeded();
 		std::string GetDefaultParameters()const;
 		std::string Help()const;
+		//number of models loaded in the process, shared by all instances
+		static size_t GetNbLoadedModels();
+		size_t GetCacheHits()const;
+		size_t GetCacheMisses()const;
 		
 
 	protected:
 
 		CModelPtr m_pModel;
+		std::shared_ptr<std::mutex> m_pModelMutex;
+		bool m_bThreadSafe;
+		CSingleFlightPtr m_pSingleFlight;
+		CTeleIOCachePtr m_pCache;
 
+		CTeleIO ExecuteOutput(const CModelExecutionOptions& options, const CTeleIOView& input, CPhaseTimer& timer)const;
+		CTeleIO ExecuteWeather(const CModelExecutionOptions& options, const CSimulationPointVector& simulationPoints, CPhaseTimer& timer)const;
 		
-		static void FillTransferInfo(const CModel& model, const CLocation& locations, const CModelInput& modelInput, size_t seed, size_t r, size_t n_r, CTransferInfoIn& info);
+		static void FillTransferInfo(const CModel& model, const CLocation& locations, const CModelInput& modelInput, size_t seed, size_t p, size_t n_p, size_t r, size_t n_r, CTransferInfoIn& info);
 	};
 
 	
-	ERMsg LoadWeather(const CTeleIO& IO, CSimulationPointVector& simulationPoints);
+	ERMsg LoadWeather(const CTeleIOView& IO, CSimulationPointVector& simulationPoints);
 
 	DLL_EXPORT std::string BioSIMAPI_SecondToDHMS(double time);
 
@@ -1,12 +1,15 @@
 #include <valarray>
 #include <array>
+#include <algorithm>
 #include <gtest/gtest.h>
 #include <filesystem>
 #include <fstream> 
+#include <thread>
 
 #include "BioSIM_API.h"
 #include "BioSIM_APITest.h"
 #include "Basic/UtilStd.h"
+#include "Basic/nlohmann/json.hpp"
 
 using namespace std;
 
@@ -178,5 +181,967 @@ namespace BioSIM_APITest
     WBSF::CTeleIO WGout = weatherGen.Generate(options);
     EXPECT_EQ(WGout.m_msg, "Success") << "Generate should return Success";
   }
+
+  TEST(BioSIMCoreTests, Test10_WeatherGenerator_Concurrent_Generate)
+  {
+    // Here we test that many threads can call Generate on the same instance and get the same results as a serial call.
+    std::string options = "Normals=testData/Weather/Normals/World 1991-2020.NormalsDB.bin.gz&Daily=testData/Weather/Daily/Demo 2008-2010.DailyDB.bin.gz";
+    WBSF::CWeatherGeneratorAPI weatherGen("");
+    std::string msg = weatherGen.Initialize(options);
+    EXPECT_EQ(msg, "Success") << "WeatherGenerator initialization should return Success";
+
+    options = "Latitude=47&Longitude=-70&Elevation=300&compress=0&Variables=TN+T+TX+P&Source=FromObservation&First_year=2009&Last_year=2009&Replications=1&Seed=1";
+    WBSF::CTeleIO WGref = weatherGen.Generate(options);
+    EXPECT_EQ(WGref.m_msg, "Success") << "Generate should return Success";
+
+    std::vector<WBSF::CTeleIO> WGout(8);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < WGout.size(); i++)
+      threads.emplace_back([&, i]() { WGout[i] = weatherGen.Generate(options); });
+
+    for (size_t i = 0; i < threads.size(); i++)
+      threads[i].join();
+
+    for (size_t i = 0; i < WGout.size(); i++)
+    {
+      EXPECT_EQ(WGout[i].m_msg, "Success") << "Generate should return Success";
+      EXPECT_TRUE(WGout[i] == WGref) << "Concurrent WG outputs should be the same as the serial output";
+    }
+  }
+
+  TEST(BioSIMCoreTests, Test11_WeatherGenerator_GenerateBatch)
+  {
+    // Here we test that a batch request give, for the first location, the same results as a single Generate call with the same seed.
+    std::string options = "Normals=testData/Weather/Normals/World 1991-2020.NormalsDB.bin.gz&Daily=testData/Weather/Daily/Demo 2008-2010.DailyDB.bin.gz";
+    WBSF::CWeatherGeneratorAPI weatherGen("");
+    std::string msg = weatherGen.Initialize(options);
+    EXPECT_EQ(msg, "Success") << "WeatherGenerator initialization should return Success";
+
+    options = "compress=0&Variables=TN+T+TX+P&Source=FromObservation&First_year=2009&Last_year=2009&Replications=1&Seed=1";
+    WBSF::CTeleIO WGref = weatherGen.Generate(options + "&ID=1&Name=Loc1&Latitude=47&Longitude=-70&Elevation=300");
+    EXPECT_EQ(WGref.m_msg, "Success") << "Generate should return Success";
+
+    std::string locations = "[{\"ID\":\"1\",\"Name\":\"Loc1\",\"Latitude\":47,\"Longitude\":-70,\"Elevation\":300},{\"Latitude\":46.5,\"Longitude\":-71,\"Elevation\":200},{\"Latitude\":46.8,\"Longitude\":-71.2}]";
+    WBSF::CTeleIO WGbatch = weatherGen.GenerateBatch(options, locations);
+    EXPECT_EQ(WGbatch.m_msg, "Success") << "GenerateBatch should return Success";
+
+    nlohmann::json metadata = nlohmann::json::parse(WGbatch.m_metadata);
+    ASSERT_EQ(metadata["Locations"].size(), 3) << "GenerateBatch should return metadata for all locations";
+
+    size_t offset = metadata["Locations"][0]["Offset"];
+    size_t size = metadata["Locations"][0]["Size"];
+    EXPECT_EQ(WGbatch.m_data.substr(offset, size), WGref.m_data) << "First location of the batch should be the same as the single Generate call";
+  }
+
+  TEST(BioSIMCoreTests, Test12_WeatherGenerator_Parallel_Replications)
+  {
+    // Here we test that replications generated in parallel give the same results whatever the number of threads.
+    std::string options = "Normals=testData/Weather/Normals/World 1991-2020.NormalsDB.bin.gz&Daily=testData/Weather/Daily/Demo 2008-2010.DailyDB.bin.gz";
+    WBSF::CWeatherGeneratorAPI weatherGenSerial("");
+    std::string msg = weatherGenSerial.Initialize(options + "&NbCPU=1");
+    EXPECT_EQ(msg, "Success") << "WeatherGenerator initialization should return Success";
+
+    WBSF::CWeatherGeneratorAPI weatherGenParallel("");
+    msg = weatherGenParallel.Initialize(options + "&NbCPU=0");
+    EXPECT_EQ(msg, "Success") << "WeatherGenerator initialization should return Success";
+
+    // from normals: replications generated in parallel
+    options = "Latitude=47&Longitude=-70&Elevation=300&compress=0&Variables=TN+T+TX+P&Source=FromNormals&NB_YEARS=2&Replications=20&Seed=1";
+    WBSF::CTeleIO WGserial = weatherGenSerial.Generate(options);
+    WBSF::CTeleIO WGparallel = weatherGenParallel.Generate(options);
+    EXPECT_EQ(WGserial.m_msg, "Success") << "Generate should return Success";
+    EXPECT_EQ(WGparallel.m_msg, "Success") << "Generate should return Success";
+    EXPECT_TRUE(WGserial == WGparallel) << "WG outputs should be the same whatever the number of threads";
+
+    // from observations: stations matched once, replications serialized in parallel
+    options = "Latitude=47&Longitude=-70&Elevation=300&compress=0&Variables=TN+T+TX+P&Source=FromObservation&First_year=2009&Last_year=2009&Replications=5&Seed=1";
+    WGserial = weatherGenSerial.Generate(options);
+    WGparallel = weatherGenParallel.Generate(options);
+    EXPECT_EQ(WGserial.m_msg, "Success") << "Generate should return Success";
+    EXPECT_EQ(WGparallel.m_msg, "Success") << "Generate should return Success";
+    EXPECT_TRUE(WGserial == WGparallel) << "WG outputs should be the same whatever the number of threads";
+  }
+
+  TEST(BioSIMCoreTests, Test13_WeatherGenerator_Cache)
+  {
+    // Here we test that a deterministic request is returned from the cache the second time.
+    std::string options = "Normals=testData/Weather/Normals/World 1991-2020.NormalsDB.bin.gz&Daily=testData/Weather/Daily/Demo 2008-2010.DailyDB.bin.gz&CacheSize=10";
+    WBSF::CWeatherGeneratorAPI weatherGen("");
+    std::string msg = weatherGen.Initialize(options);
+    EXPECT_EQ(msg, "Success") << "WeatherGenerator initialization should return Success";
+
+    options = "Latitude=47&Longitude=-70&Elevation=300&compress=0&Variables=TN+T+TX+P&Source=FromObservation&First_year=2009&Last_year=2009&Replications=1&Seed=1";
+    WBSF::CTeleIO WGout1 = weatherGen.Generate(options);
+    EXPECT_EQ(WGout1.m_msg, "Success") << "Generate should return Success";
+
+    // same request with options in another order and case
+    options = "seed=1&Replications=1&Last_year=2009&First_year=2009&Source=FromObservation&Variables=TN+T+TX+P&compress=0&Elevation=300&Longitude=-70&Latitude=47";
+    WBSF::CTeleIO WGout2 = weatherGen.Generate(options);
+    EXPECT_EQ(WGout2.m_msg, "Success") << "Generate should return Success";
+
+    EXPECT_TRUE(WGout1 == WGout2) << "Cached output should be the same";
+    EXPECT_EQ(weatherGen.GetCacheMisses(), 1) << "First request should be a cache miss";
+    EXPECT_EQ(weatherGen.GetCacheHits(), 1) << "Second request should be a cache hit";
+
+    // coordinates that differ after the 6th decimal are another request
+    options = "Latitude=47.0000001&Longitude=-70&Elevation=300&compress=0&Variables=TN+T+TX+P&Source=FromObservation&First_year=2009&Last_year=2009&Replications=1&Seed=1";
+    WBSF::CTeleIO WGout3 = weatherGen.Generate(options);
+    EXPECT_EQ(WGout3.m_msg, "Success") << "Generate should return Success";
+    EXPECT_EQ(weatherGen.GetCacheMisses(), 2) << "Request with other coordinates should be a cache miss";
+    EXPECT_EQ(weatherGen.GetCacheHits(), 1) << "Request with other coordinates should not be a cache hit";
+  }
+
+  TEST(BioSIMCoreTests, Test14_Concurrent_Identical_Requests)
+  {
+    // Here we test that identical concurrent deterministic requests all get the same result.
+    std::string options = "Normals=testData/Weather/Normals/World 1991-2020.NormalsDB.bin.gz&Daily=testData/Weather/Daily/Demo 2008-2010.DailyDB.bin.gz";
+    WBSF::CWeatherGeneratorAPI weatherGen("");
+    std::string msg = weatherGen.Initialize(options);
+    EXPECT_EQ(msg, "Success") << "WeatherGenerator initialization should return Success";
+
+    WBSF::CModelExecutionAPI model("");
+    msg = model.Initialize("Model=DegreeDay(Annual).mdl");
+    EXPECT_EQ(msg, "Success") << "ModelExecutionAPI initialization should return Success";
+
+    options = "Latitude=47&Longitude=-70&Elevation=300&compress=0&Variables=TN+T+TX+P&Source=FromObservation&First_year=2009&Last_year=2009&Replications=1&Seed=1";
+
+    std::vector<WBSF::CTeleIO> WGout(8);
+    std::vector<WBSF::CTeleIO> modelOut(8);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < WGout.size(); i++)
+    {
+      threads.emplace_back([&, i]()
+        {
+          WGout[i] = weatherGen.Generate(options);
+          modelOut[i] = model.Execute("Compress=0&Seed=1", WGout[i]);
+        });
+    }
+
+    for (size_t i = 0; i < threads.size(); i++)
+      threads[i].join();
+
+    for (size_t i = 0; i < WGout.size(); i++)
+    {
+      EXPECT_EQ(WGout[i].m_msg, "Success") << "Generate should return Success";
+      EXPECT_EQ(modelOut[i].m_msg, "Success") << "Execute should return Success";
+      EXPECT_TRUE(WGout[i] == WGout[0]) << "Identical WG requests should give the same output";
+      EXPECT_TRUE(modelOut[i] == modelOut[0]) << "Identical model requests should give the same output";
+    }
+  }
+
+  TEST(BioSIMCoreTests, Test15_Timing_Metadata)
+  {
+    // Here we test that the time of each phase is reported outside of the content.
+    std::string options = "Normals=testData/Weather/Normals/World 1991-2020.NormalsDB.bin.gz&Daily=testData/Weather/Daily/Demo 2008-2010.DailyDB.bin.gz";
+    WBSF::CWeatherGeneratorAPI weatherGen("");
+    std::string msg = weatherGen.Initialize(options);
+    EXPECT_EQ(msg, "Success") << "WeatherGenerator initialization should return Success";
+
+    options = "Latitude=47&Longitude=-70&compress=0&Variables=TN+T+TX+P&Source=FromObservation&First_year=2009&Last_year=2009&Replications=2&Seed=1";
+    WBSF::CTeleIO WGout = weatherGen.Generate(options);
+    EXPECT_EQ(WGout.m_msg, "Success") << "Generate should return Success";
+    EXPECT_EQ(WGout.m_metadata.find("Timing"), std::string::npos) << "Metadata should not contain timing";
+
+    nlohmann::json timing = nlohmann::json::parse(WGout.m_timing);
+    ASSERT_TRUE(timing.is_array() && !timing.empty()) << "Timing should be an array of phases";
+
+    std::vector<std::string> phases;
+    for (const auto& p : timing)
+    {
+      phases.push_back(p["Phase"]);
+      EXPECT_TRUE(p.contains("Wall") || p.contains("ThreadCPU")) << "Phase should be timed by the call or by threads";
+      EXPECT_GE(p.value("Wall", 0.0), 0) << "Wall time should be positive";
+      EXPECT_GE(p.value("CPU", 0.0), 0) << "CPU time should be positive";
+      EXPECT_GE(p.value("ThreadCPU", 0.0), 0) << "Thread CPU time should be positive";
+    }
+
+    // no cache configured: no cache phase
+    std::vector<std::string> expected = { "Parse", "Elevation", "Generation", "Serialization", "Compression", "Total" };
+    EXPECT_EQ(phases, expected) << "Timing should report all phases in order";
+
+    // serial phases are inside the total
+    double total = timing.back()["Wall"];
+    EXPECT_GT(total, 0) << "Total wall time should be greater than 0";
+    EXPECT_LE(timing[0]["Wall"].get<double>(), total) << "Parse should be inside the total";
+    EXPECT_GT(timing[2]["Wall"].get<double>(), 0) << "Generation should take time";
+
+    // parallel phases are timed once: never more wall time than the whole call
+    double sum = 0;
+    for (size_t i = 0; i + 1 < timing.size(); i++)
+      sum += timing[i].value("Wall", 0.0);
+    EXPECT_LE(sum, total) << "Phases wall time should be inside the total";
+    EXPECT_FALSE(timing[3].contains("Wall")) << "Serialization is done by the threads of the generation";
+    EXPECT_TRUE(timing[3].contains("ThreadCPU")) << "Serialization should report the CPU time of the threads";
+
+    // the same request give the same content, whatever the timing
+    WBSF::CTeleIO WGout2 = weatherGen.Generate(options);
+    EXPECT_EQ(WGout2.m_metadata, WGout.m_metadata) << "Metadata should be the same for the same request";
+    EXPECT_TRUE(WGout2 == WGout) << "Output should be the same for the same request";
+
+    // model: the model run is separated from the transfer streams
+    WBSF::CModelExecutionAPI model("");
+    msg = model.Initialize("Model=DegreeDay(Annual).mdl");
+    EXPECT_EQ(msg, "Success") << "ModelExecutionAPI initialization should return Success";
+
+    WBSF::CTeleIO modelOut = model.Execute("Compress=0&Seed=1", WGout);
+    EXPECT_EQ(modelOut.m_msg, "Success") << "Execute should return Success";
+
+    phases.clear();
+    for (const auto& p : nlohmann::json::parse(modelOut.m_timing))
+      phases.push_back(p["Phase"]);
+
+    EXPECT_NE(std::find(phases.begin(), phases.end(), "Execution"), phases.end()) << "Timing should report the parallel runs";
+    EXPECT_NE(std::find(phases.begin(), phases.end(), "Transfer"), phases.end()) << "Timing should report the transfer streams";
+    EXPECT_NE(std::find(phases.begin(), phases.end(), "Model"), phases.end()) << "Timing should report the model run";
+    EXPECT_EQ(std::find(phases.begin(), phases.end(), "Cache"), phases.end()) << "No cache phase without cache";
+  }
+
+  TEST(BioSIMCoreTests, Test16_Shared_Databases)
+  {
+    // Here we test that two instances opening the same databases share one loaded copy.
+    std::string options = "Normals=testData/Weather/Normals/World 1991-2020.NormalsDB.bin.gz&Daily=testData/Weather/Daily/Demo 2008-2010.DailyDB.bin.gz";
+    WBSF::CWeatherGeneratorAPI weatherGen1("");
+    std::string msg = weatherGen1.Initialize(options);
+    EXPECT_EQ(msg, "Success") << "WeatherGenerator initialization should return Success";
+
+    size_t nbDatabases = WBSF::CWeatherGeneratorAPI::GetNbLoadedDatabases();
+
+    WBSF::CWeatherGeneratorAPI weatherGen2("");
+    msg = weatherGen2.Initialize(options);
+    EXPECT_EQ(msg, "Success") << "WeatherGenerator initialization should return Success";
+    EXPECT_EQ(WBSF::CWeatherGeneratorAPI::GetNbLoadedDatabases(), nbDatabases) << "Second instance should reuse the loaded databases";
+
+    options = "Latitude=47&Longitude=-70&Elevation=300&compress=0&Variables=TN+T+TX+P&Source=FromObservation&First_year=2009&Last_year=2009&Replications=1&Seed=1";
+    WBSF::CTeleIO WGout1 = weatherGen1.Generate(options);
+    WBSF::CTeleIO WGout2 = weatherGen2.Generate(options);
+    EXPECT_EQ(WGout1.m_msg, "Success") << "Generate should return Success";
+    EXPECT_TRUE(WGout1 == WGout2) << "Instances sharing databases should give the same output";
+  }
+
+  TEST(BioSIMCoreTests, Test16_Shared_Databases_Concurrent_Load)
+  {
+    // Here we test that instances initialized concurrently load each database only once.
+    std::string options = "Normals=testData/Weather/Normals/World 1991-2020.NormalsDB.bin.gz&Daily=testData/Weather/Daily/Demo 2008-2010.DailyDB.bin.gz";
+    size_t nbDatabases = WBSF::CWeatherGeneratorAPI::GetNbLoadedDatabases();
+
+    std::vector<std::unique_ptr<WBSF::CWeatherGeneratorAPI>> weatherGens(4);
+    std::vector<std::string> msgs(weatherGens.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < weatherGens.size(); i++)
+    {
+      weatherGens[i] = std::make_unique<WBSF::CWeatherGeneratorAPI>("");
+      threads.emplace_back([&, i]() { msgs[i] = weatherGens[i]->Initialize(options); });
+    }
+
+    for (size_t i = 0; i < threads.size(); i++)
+      threads[i].join();
+
+    for (size_t i = 0; i < msgs.size(); i++)
+      EXPECT_EQ(msgs[i], "Success") << "WeatherGenerator initialization should return Success";
+
+    EXPECT_LE(WBSF::CWeatherGeneratorAPI::GetNbLoadedDatabases(), nbDatabases + 2) << "Normals and daily databases should be loaded only once";
+  }
+
+  TEST(BioSIMCoreTests, Test17_Reload_Daily_Database)
+  {
+    // Here we test that the daily database can be reloaded while Generate calls are in progress.
+    std::string options = "Normals=testData/Weather/Normals/World 1991-2020.NormalsDB.bin.gz&Daily=testData/Weather/Daily/Demo 2008-2010.DailyDB.bin.gz";
+    WBSF::CWeatherGeneratorAPI weatherGen("");
+    std::string msg = weatherGen.Initialize(options);
+    EXPECT_EQ(msg, "Success") << "WeatherGenerator initialization should return Success";
+
+    options = "Latitude=47&Longitude=-70&Elevation=300&compress=0&Variables=TN+T+TX+P&Source=FromObservation&First_year=2009&Last_year=2009&Replications=1&Seed=1";
+    WBSF::CTeleIO WGref = weatherGen.Generate(options);
+    EXPECT_EQ(WGref.m_msg, "Success") << "Generate should return Success";
+
+    std::vector<WBSF::CTeleIO> WGout(4);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < WGout.size(); i++)
+      threads.emplace_back([&, i]() { WGout[i] = weatherGen.Generate(options); });
+
+    std::string reloadMsg = weatherGen.Reload();
+
+    for (size_t i = 0; i < threads.size(); i++)
+      threads[i].join();
+
+    EXPECT_EQ(reloadMsg, "Success") << "Reload should return Success";
+    for (size_t i = 0; i < WGout.size(); i++)
+      EXPECT_TRUE(WGout[i] == WGref) << "Generate should not be affected by the reload of the same data";
+
+    WBSF::CTeleIO WGafter = weatherGen.Generate(options);
+    EXPECT_TRUE(WGafter == WGref) << "Generate after reload should give the same output";
+  }
+
+  TEST(BioSIMCoreTests, Test17_Reload_Changed_Daily_Database)
+  {
+    // Here we test that a reload of a changed daily database is used by the next calls and not by the cache.
+    std::filesystem::path DB_path = std::filesystem::temp_directory_path() / "BioSIM_APITest_Reload.DailyDB.bin.gz";
+    std::filesystem::copy_file("testData/Weather/Daily/Demo 2008-2010.DailyDB.bin.gz", DB_path, std::filesystem::copy_options::overwrite_existing);
+
+    std::string options = "Normals=testData/Weather/Normals/World 1991-2020.NormalsDB.bin.gz&Daily=" + DB_path.string() + "&CacheSize=10";
+    WBSF::CWeatherGeneratorAPI weatherGen("");
+    std::string msg = weatherGen.Initialize(options);
+    EXPECT_EQ(msg, "Success") << "WeatherGenerator initialization should return Success";
+
+    // 2006 is only in the second database
+    options = "Latitude=47&Longitude=-70&Elevation=300&compress=0&Variables=TN+T+TX+P&Source=FromObservation&First_year=2006&Last_year=2006&Replications=1&Seed=1";
+    WBSF::CTeleIO WGbefore = weatherGen.Generate(options);
+
+    std::filesystem::copy_file("testData/Weather/Daily/Demo 2005-2010.DailyDB.bin.gz", DB_path, std::filesystem::copy_options::overwrite_existing);
+    msg = weatherGen.Reload();
+    EXPECT_EQ(msg, "Success") << "Reload should return Success";
+
+    WBSF::CTeleIO WGafter = weatherGen.Generate(options);
+    EXPECT_EQ(WGafter.m_msg, "Success") << "Generate should return Success";
+    EXPECT_FALSE(WGafter == WGbefore) << "Generate after reload should use the new database";
+    EXPECT_EQ(weatherGen.GetCacheHits(), 0) << "Results of the previous database should not be returned";
+
+    std::filesystem::remove(DB_path);
+  }
+
+  TEST(BioSIMCoreTests, Test18_WeatherGenerator_GenerateStream)
+  {
+    // Here we test that the streamed chunks give the same data as Generate.
+    std::string options = "Normals=testData/Weather/Normals/World 1991-2020.NormalsDB.bin.gz&Daily=testData/Weather/Daily/Demo 2008-2010.DailyDB.bin.gz";
+    WBSF::CWeatherGeneratorAPI weatherGen("");
+    std::string msg = weatherGen.Initialize(options);
+    EXPECT_EQ(msg, "Success") << "WeatherGenerator initialization should return Success";
+
+    options = "Latitude=47&Longitude=-70&Elevation=300&compress=0&Variables=TN+T+TX+P&Source=FromObservation&First_year=2009&Last_year=2009&Replications=3&Seed=1";
+    WBSF::CTeleIO WGout = weatherGen.Generate(options);
+    EXPECT_EQ(WGout.m_msg, "Success") << "Generate should return Success";
+
+    std::string data;
+    size_t nbChunks = 0;
+    WBSF::CTeleIO WGstream = weatherGen.GenerateStream(options, [&](const std::string& chunk) { data += chunk; nbChunks++; });
+    EXPECT_EQ(WGstream.m_msg, "Success") << "GenerateStream should return Success";
+    EXPECT_TRUE(WGstream.m_data.empty()) << "Streamed data should not be kept in the output";
+    EXPECT_GT(nbChunks, 0) << "Data should be sent by chunks";
+    EXPECT_EQ(data, WGout.m_data) << "Streamed data should be the same as Generate";
+  }
+
+  TEST(BioSIMCoreTests, Test19_Binary_Format)
+  {
+    // Here we test that the binary columnar format can be generated and executed.
+    std::string options = "Normals=testData/Weather/Normals/World 1991-2020.NormalsDB.bin.gz&Daily=testData/Weather/Daily/Demo 2008-2010.DailyDB.bin.gz";
+    WBSF::CWeatherGeneratorAPI weatherGen("");
+    std::string msg = weatherGen.Initialize(options);
+    EXPECT_EQ(msg, "Success") << "WeatherGenerator initialization should return Success";
+
+    WBSF::CModelExecutionAPI model("");
+    msg = model.Initialize("Model=DegreeDay(Annual).mdl");
+    EXPECT_EQ(msg, "Success") << "ModelExecutionAPI initialization should return Success";
+
+    options = "Latitude=47&Longitude=-70&Elevation=300&compress=0&Variables=TN+T+TX+P&Source=FromObservation&First_year=2008&Last_year=2010&Replications=2&Seed=1";
+    WBSF::CTeleIO WGcsv = weatherGen.Generate(options);
+    WBSF::CTeleIO WGbinary = weatherGen.Generate(options + "&Format=Binary");
+    EXPECT_EQ(WGcsv.m_msg, "Success") << "Generate should return Success";
+    EXPECT_EQ(WGbinary.m_msg, "Success") << "Generate binary should return Success";
+    EXPECT_EQ(WGbinary.m_data.substr(0, 4), "BSWB") << "Binary data should start with the magic";
+    EXPECT_LT(WGbinary.m_data.size(), WGcsv.m_data.size()) << "Binary data should be smaller than CSV";
+
+    WBSF::CTeleIO modelCsv = model.Execute("Compress=0&Seed=1", WGcsv);
+    WBSF::CTeleIO modelBinary = model.Execute("Compress=0&Seed=1", WGbinary);
+    EXPECT_EQ(modelCsv.m_msg, "Success") << "Execute should return Success";
+    EXPECT_EQ(modelBinary.m_msg, "Success") << "Execute of binary weather should return Success";
+
+    // CSV weather is rounded: results are compared value by value within a tolerance
+    auto split = [](const std::string& data)
+    {
+      std::vector<std::string> values;
+      std::string value;
+      for (char c : data)
+      {
+        if (c == ',' || c == '\n' || c == '\r')
+        {
+          if (!value.empty())
+            values.push_back(value);
+          value.clear();
+        }
+        else
+        {
+          value += c;
+        }
+      }
+      if (!value.empty())
+        values.push_back(value);
+      return values;
+    };
+
+    std::vector<std::string> valuesCsv = split(modelCsv.m_data);
+    std::vector<std::string> valuesBinary = split(modelBinary.m_data);
+    ASSERT_EQ(valuesBinary.size(), valuesCsv.size()) << "Binary and CSV weather should give the same number of results";
+    for (size_t i = 0; i < valuesCsv.size(); i++)
+    {
+      char* pEnd = nullptr;
+      double csv = strtod(valuesCsv[i].c_str(), &pEnd);
+      if (*pEnd == 0)
+        EXPECT_NEAR(strtod(valuesBinary[i].c_str(), nullptr), csv, std::max(0.1, 0.01 * std::abs(csv))) << "Binary and CSV weather should give the same results: value " << i;
+      else
+        EXPECT_EQ(valuesBinary[i], valuesCsv[i]) << "Binary and CSV weather should give the same header";
+    }
+
+    WBSF::CTeleIO WGcompressed = weatherGen.Generate(options + "&Format=Binary&Compress=1");
+    WBSF::CTeleIO modelCompressed = model.Execute("Compress=0&Seed=1", WGcompressed);
+    EXPECT_TRUE(modelCompressed == modelBinary) << "Compressed binary weather should give the same results";
+
+    // invalid binary data return an error instead of throwing or allocating
+    WBSF::CTeleIO truncated = WGbinary;
+    truncated.m_data.resize(truncated.m_data.size() - 1);
+    EXPECT_NE(model.Execute("Compress=0&Seed=1", truncated).m_msg, "Success") << "Truncated binary weather should return an error";
+
+    WBSF::CTeleIO bigHeader = WGbinary;
+    bigHeader.m_data.replace(8, 4, std::string(4, '\xFF'));
+    EXPECT_NE(model.Execute("Compress=0&Seed=1", bigHeader).m_msg, "Success") << "Header size larger than the data should return an error";
+
+    WBSF::CTeleIO badHeader = WGbinary;
+    size_t pos = badHeader.m_data.find("\"NbSteps\":");
+    ASSERT_NE(pos, std::string::npos);
+    badHeader.m_data[pos + 10] = 'x';
+    EXPECT_NE(model.Execute("Compress=0&Seed=1", badHeader).m_msg, "Success") << "Invalid JSON header should return an error";
+
+    WBSF::CTeleIO manyReplications = WGbinary;
+    pos = manyReplications.m_data.find("\"Replications\":2");
+    ASSERT_NE(pos, std::string::npos);
+    manyReplications.m_data[pos + 15] = '9';
+    EXPECT_NE(model.Execute("Compress=0&Seed=1", manyReplications).m_msg, "Success") << "Replications not matching the data size should return an error";
+
+    // header with a valid size but an impossible date or no replication
+    auto makeBinary = [](const std::string& begin, size_t nbReplications)
+    {
+      std::string header = "{\"Location\":{\"ID\":\"1\",\"Name\":\"Loc1\",\"Latitude\":47,\"Longitude\":-70,\"Elevation\":300},\"TM\":\"Daily\",\"Begin\":" + begin +
+        ",\"NbSteps\":1,\"Variables\":[\"TN\"],\"Replications\":" + std::to_string(nbReplications) + "}";
+      uint32_t version = 1;
+      uint32_t size = uint32_t(header.size());
+      std::string data = "BSWB";
+      data.append((const char*)&version, sizeof(version));
+      data.append((const char*)&size, sizeof(size));
+      data += header;
+      data.append(nbReplications * sizeof(float), '\0');
+      return WBSF::CTeleIO(false, "", "", "", data);
+    };
+
+    EXPECT_NE(model.Execute("Compress=0&Seed=1", makeBinary("[2009,2,31,0]", 1)).m_msg, "Success") << "February 31 should return an error";
+    EXPECT_NE(model.Execute("Compress=0&Seed=1", makeBinary("[2009,4,31,0]", 1)).m_msg, "Success") << "April 31 should return an error";
+    EXPECT_NE(model.Execute("Compress=0&Seed=1", makeBinary("[2009,1,1,0]", 0)).m_msg, "Success") << "No replication should return an error";
+  }
+
+  TEST(BioSIMCoreTests, Test20_Fused_Generate_Execute)
+  {
+    // Here we test that the model can be executed directly on generated weather.
+    std::string options = "Normals=testData/Weather/Normals/World 1991-2020.NormalsDB.bin.gz&Daily=testData/Weather/Daily/Demo 2008-2010.DailyDB.bin.gz";
+    WBSF::CWeatherGeneratorAPI weatherGen("");
+    std::string msg = weatherGen.Initialize(options);
+    EXPECT_EQ(msg, "Success") << "WeatherGenerator initialization should return Success";
+
+    WBSF::CModelExecutionAPI model("");
+    msg = model.Initialize("Model=DegreeDay(Annual).mdl");
+    EXPECT_EQ(msg, "Success") << "ModelExecutionAPI initialization should return Success";
+
+    options = "Latitude=47&Longitude=-70&Elevation=300&compress=0&Variables=TN+T+TX+P&Source=FromObservation&First_year=2008&Last_year=2010&Replications=2&Seed=1";
+    WBSF::CTeleIO WGout = weatherGen.Generate(options);
+    WBSF::CTeleIO modelOut = model.Execute("Compress=0&Seed=1", WGout);
+    EXPECT_EQ(modelOut.m_msg, "Success") << "Execute should return Success";
+
+    WBSF::CTeleIO fusedOut = model.Execute("Compress=0&Seed=1", weatherGen, options);
+    EXPECT_EQ(fusedOut.m_msg, "Success") << "Fused execution should return Success";
+    EXPECT_EQ(std::count(fusedOut.m_data.begin(), fusedOut.m_data.end(), '\n'), std::count(modelOut.m_data.begin(), modelOut.m_data.end(), '\n')) << "Fused execution should give the same number of results";
+
+    WBSF::CTeleIO fusedOut2 = model.Execute("Compress=0&Seed=1", weatherGen, options);
+    EXPECT_TRUE(fusedOut == fusedOut2) << "Fused execution should be deterministic with a fixed seed";
+  }
+
+  TEST(BioSIMCoreTests, Test21_Model_Parallel_Execution)
+  {
+    // Here we test that model runs executed in parallel give the same output as the serial execution,
+    // with model calls serialized (default) or concurrent (ThreadSafe=1).
+    std::string global_options = "DailyCacheSize=50&Shore=testData/Layers/Shore.ann&DEM=testData/DEM/Demo 30s(SRTM30).tif&ModelsPath=Models/";
+    WBSF::CBioSIM_API_GlobalData global;
+
+    std::string options = "Normals=testData/Weather/Normals/World 1991-2020.NormalsDB.bin.gz";
+    WBSF::CWeatherGeneratorAPI weatherGen("");
+    std::string msg = weatherGen.Initialize(options);
+    EXPECT_EQ(msg, "Success") << "WeatherGenerator initialization should return Success";
+
+    WBSF::CModelExecutionAPI model("");
+    msg = model.Initialize("Model=DegreeDay(Annual).mdl");
+    EXPECT_EQ(msg, "Success") << "ModelExecutionAPI initialization should return Success";
+
+    options = "Latitude=47&Longitude=-70&Elevation=300&compress=0&Variables=TN+T+TX+P&Source=FromNormals&NB_YEARS=2&Replications=10&Seed=1";
+    WBSF::CTeleIO WGout = weatherGen.Generate(options);
+    EXPECT_EQ(WGout.m_msg, "Success") << "Generate should return Success";
+
+    msg = global.InitGlobalData(global_options + "&NbCPU=1");
+    EXPECT_EQ(msg, "Success") << "Global Data Initialization should return Success";
+    WBSF::CTeleIO modelSerial = model.Execute("Compress=0&Replications=5&Seed=1", WGout);
+    EXPECT_EQ(modelSerial.m_msg, "Success") << "Execute should return Success";
+
+    msg = global.InitGlobalData(global_options + "&NbCPU=0");
+    EXPECT_EQ(msg, "Success") << "Global Data Initialization should return Success";
+    WBSF::CTeleIO modelParallel = model.Execute("Compress=0&Replications=5&Seed=1", WGout);
+    EXPECT_EQ(modelParallel.m_msg, "Success") << "Execute should return Success";
+
+    EXPECT_EQ(modelSerial.m_data, modelParallel.m_data) << "Model outputs should be byte-identical whatever the number of threads";
+
+    // a model declared thread-safe is called concurrently: same output
+    WBSF::CModelExecutionAPI modelThreadSafe("");
+    msg = modelThreadSafe.Initialize("Model=DegreeDay(Annual).mdl&ThreadSafe=1");
+    EXPECT_EQ(msg, "Success") << "ModelExecutionAPI initialization should return Success";
+    WBSF::CTeleIO modelConcurrent = modelThreadSafe.Execute("Compress=0&Replications=5&Seed=1", WGout);
+    EXPECT_EQ(modelConcurrent.m_msg, "Success") << "Execute should return Success";
+    EXPECT_EQ(modelSerial.m_data, modelConcurrent.m_data) << "Model outputs should be byte-identical when the model is called concurrently";
+  }
+
+  TEST(BioSIMCoreTests, Test22_Preload_Models)
+  {
+    // Here we test that models preloaded at initialization are shared by the API instances.
+    WBSF::CBioSIM_API_GlobalData global;
+    std::string msg = global.InitGlobalData("DailyCacheSize=50&Shore=testData/Layers/Shore.ann&DEM=testData/DEM/Demo 30s(SRTM30).tif&ModelsPath=Models/&PreloadModels=1");
+    EXPECT_EQ(msg, "Success") << "Global Data Initialization should return Success";
+
+    size_t nbModels = WBSF::CModelExecutionAPI::GetNbLoadedModels();
+    EXPECT_GT(nbModels, 0) << "Models should be loaded at initialization";
+
+    WBSF::CModelExecutionAPI model1("");
+    msg = model1.Initialize("Model=DegreeDay(Annual).mdl");
+    EXPECT_EQ(msg, "Success") << "ModelExecutionAPI initialization should return Success";
+
+    WBSF::CModelExecutionAPI model2("");
+    msg = model2.Initialize("Model=DegreeDay(Annual)");
+    EXPECT_EQ(msg, "Success") << "ModelExecutionAPI initialization should return Success";
+
+    EXPECT_EQ(WBSF::CModelExecutionAPI::GetNbLoadedModels(), nbModels) << "Instances should use the preloaded models";
+    EXPECT_EQ(model1.GetDefaultParameters(), model2.GetDefaultParameters()) << "Instances should share the same model";
+  }
+
+  TEST(BioSIMCoreTests, Test23_Execute_Many_Models)
+  {
+    // Here we test that many models executed on the same weather give the same results as separate executions.
+    std::string options = "Normals=testData/Weather/Normals/World 1991-2020.NormalsDB.bin.gz&Daily=testData/Weather/Daily/Demo 2008-2010.DailyDB.bin.gz";
+    WBSF::CWeatherGeneratorAPI weatherGen("");
+    std::string msg = weatherGen.Initialize(options);
+    EXPECT_EQ(msg, "Success") << "WeatherGenerator initialization should return Success";
+
+    WBSF::CModelExecutionAPI model1("");
+    msg = model1.Initialize("Model=DegreeDay(Annual).mdl");
+    EXPECT_EQ(msg, "Success") << "ModelExecutionAPI initialization should return Success";
+
+    WBSF::CModelExecutionAPI model2("");
+    msg = model2.Initialize("Model=Climatic(Annual).mdl");
+    EXPECT_EQ(msg, "Success") << "ModelExecutionAPI initialization should return Success";
+
+    options = "Latitude=47&Longitude=-70&Elevation=300&compress=1&Variables=TN+T+TX+P&Source=FromObservation&First_year=2008&Last_year=2010&Replications=2&Seed=1";
+    WBSF::CTeleIO WGout = weatherGen.Generate(options);
+    EXPECT_EQ(WGout.m_msg, "Success") << "Generate should return Success";
+
+    WBSF::CTeleIO modelOut1 = model1.Execute("Compress=0&Seed=1", WGout);
+    WBSF::CTeleIO modelOut2 = model2.Execute("Compress=0&Seed=2", WGout);
+
+    WBSF::CTeleIO modelsOut = WBSF::CModelExecutionAPI::ExecuteModels({ &model1, &model2 }, { "Compress=0&Seed=1", "Compress=0&Seed=2" }, WGout);
+    EXPECT_EQ(modelsOut.m_msg, "Success") << "ExecuteModels should return Success";
+
+    nlohmann::json metadata = nlohmann::json::parse(modelsOut.m_metadata);
+    ASSERT_EQ(metadata["Models"].size(), 2) << "Metadata should have one section by model";
+
+    size_t offset1 = metadata["Models"][0]["Offset"];
+    size_t size1 = metadata["Models"][0]["Size"];
+    size_t offset2 = metadata["Models"][1]["Offset"];
+    size_t size2 = metadata["Models"][1]["Size"];
+    EXPECT_EQ(modelsOut.m_data.substr(offset1, size1), modelOut1.m_data) << "First section should be the same as the first model execution";
+    EXPECT_EQ(modelsOut.m_data.substr(offset2, size2), modelOut2.m_data) << "Second section should be the same as the second model execution";
+
+    // models run in parallel: results are in the order of the models, also when a model is given twice
+    WBSF::CTeleIO modelOut3 = model1.Execute("Compress=0&Seed=3", WGout);
+    modelsOut = WBSF::CModelExecutionAPI::ExecuteModels({ &model1, &model2, &model1 }, { "Compress=0&Seed=1", "Compress=0&Seed=2", "Compress=0&Seed=3" }, WGout);
+    EXPECT_EQ(modelsOut.m_msg, "Success") << "ExecuteModels should return Success";
+
+    metadata = nlohmann::json::parse(modelsOut.m_metadata);
+    ASSERT_EQ(metadata["Models"].size(), 3) << "Metadata should have one section by model";
+
+    std::vector<const WBSF::CTeleIO*> expected = { &modelOut1, &modelOut2, &modelOut3 };
+    for (size_t m = 0; m < expected.size(); m++)
+    {
+      size_t offset = metadata["Models"][m]["Offset"];
+      size_t size = metadata["Models"][m]["Size"];
+      EXPECT_EQ(modelsOut.m_data.substr(offset, size), expected[m]->m_data) << "Section " << m + 1 << " should be the same as the model execution";
+    }
+  }
+
+  TEST(BioSIMCoreTests, Test24_Model_Parameters_Sweep)
+  {
+    // Here we test that each parameters set of a sweep give the same results as a single execution.
+    std::string options = "Normals=testData/Weather/Normals/World 1991-2020.NormalsDB.bin.gz&Daily=testData/Weather/Daily/Demo 2008-2010.DailyDB.bin.gz";
+    WBSF::CWeatherGeneratorAPI weatherGen("");
+    std::string msg = weatherGen.Initialize(options);
+    EXPECT_EQ(msg, "Success") << "WeatherGenerator initialization should return Success";
+
+    WBSF::CModelExecutionAPI model("");
+    msg = model.Initialize("Model=DegreeDay(Annual).mdl");
+    EXPECT_EQ(msg, "Success") << "ModelExecutionAPI initialization should return Success";
+
+    options = "Latitude=47&Longitude=-70&Elevation=300&compress=0&Variables=TN+T+TX+P&Source=FromObservation&First_year=2008&Last_year=2010&Replications=2&Seed=1";
+    WBSF::CTeleIO WGout = weatherGen.Generate(options);
+    EXPECT_EQ(WGout.m_msg, "Success") << "Generate should return Success";
+
+    std::string parameters = model.GetDefaultParameters();
+    parameters.erase(parameters.find_last_not_of("\n") + 1);
+
+    // the first numeric parameter is varied, the others keep their default value
+    std::vector<std::string> params;
+    for (size_t pos = 0, next = 0; pos <= parameters.size(); pos = next + 1)
+    {
+      next = std::min(parameters.find('+', pos), parameters.size());
+      params.push_back(parameters.substr(pos, next - pos));
+    }
+
+    size_t varied = params.size();
+    double value = 0;
+    for (size_t i = 0; i < params.size() && varied == params.size(); i++)
+    {
+      std::string str = params[i].substr(params[i].find(':') + 1);
+      char* pEnd = nullptr;
+      value = strtod(str.c_str(), &pEnd);
+      if (!str.empty() && *pEnd == 0)
+        varied = i;
+    }
+    ASSERT_LT(varied, params.size()) << "Model should have a numeric parameter";
+
+    std::string name = params[varied].substr(0, params[varied].find(':'));
+    auto getParameters = [&](const std::string& values)
+    {
+      std::string str;
+      for (size_t i = 0; i < params.size(); i++)
+        str += (i == 0 ? "" : "+") + (i == varied ? name + ":" + values : params[i]);
+      return str;
+    };
+
+    // a grid of 2 values and a second set: 3 parameters sets
+    std::vector<std::string> values = { std::to_string(value), std::to_string(value + 1), std::to_string(value + 2) };
+    std::string sweepParameters = getParameters(values[0] + "|" + values[1]) + ";" + getParameters(values[2]);
+    WBSF::CTeleIO sweep = model.Execute("Compress=0&Seed=1&Parameters=" + sweepParameters, WGout);
+    EXPECT_EQ(sweep.m_msg, "Success") << "Sweep should return Success";
+
+    nlohmann::json metadata = nlohmann::json::parse(sweep.m_metadata);
+    ASSERT_EQ(metadata["ParameterSets"].size(), values.size()) << "Metadata should have one section by parameters set";
+
+    std::vector<std::string> results;
+    for (size_t i = 0; i < values.size(); i++)
+    {
+      WBSF::CTeleIO single = model.Execute("Compress=0&Seed=1&Parameters=" + getParameters(values[i]), WGout);
+      EXPECT_EQ(single.m_msg, "Success") << "Execute should return Success";
+
+      const auto& section = metadata["ParameterSets"][i];
+      size_t offset = section["Offset"];
+      size_t size = section["Size"];
+      results.push_back(sweep.m_data.substr(offset, size));
+      EXPECT_EQ(results.back(), single.m_data) << "Parameters set " << i + 1 << " should give the same results as a single execution";
+    }
+    EXPECT_NE(results[0], results[1]) << "Grid values should give different results";
+
+    // escaped delimiters are part of the value: one set with an invalid parameter, not two sets
+    WBSF::CTeleIO escaped = model.Execute("Compress=0&Seed=1&Parameters=" + parameters + "+Unknown:a\\;b\\|c", WGout);
+    EXPECT_NE(escaped.m_msg.find("Unknown:a;b|c"), std::string::npos) << "Escaped delimiters should be kept in the value";
+  }
+
+  TEST(BioSIMCoreTests, Test25_Model_Replications_Statistics)
+  {
+    // Here we test that statistics over replications replace the results of all replications.
+    std::string options = "Normals=testData/Weather/Normals/World 1991-2020.NormalsDB.bin.gz";
+    WBSF::CWeatherGeneratorAPI weatherGen("");
+    std::string msg = weatherGen.Initialize(options);
+    EXPECT_EQ(msg, "Success") << "WeatherGenerator initialization should return Success";
+
+    WBSF::CModelExecutionAPI model("");
+    msg = model.Initialize("Model=DegreeDay(Annual).mdl");
+    EXPECT_EQ(msg, "Success") << "ModelExecutionAPI initialization should return Success";
+
+    options = "Latitude=47&Longitude=-70&Elevation=300&compress=0&Variables=TN+T+TX+P&Source=FromNormals&NB_YEARS=2&Replications=20&Seed=1";
+    WBSF::CTeleIO WGout = weatherGen.Generate(options);
+    EXPECT_EQ(WGout.m_msg, "Success") << "Generate should return Success";
+
+    WBSF::CTeleIO all = model.Execute("Compress=0&Seed=1", WGout);
+    EXPECT_EQ(all.m_msg, "Success") << "Execute should return Success";
+
+    WBSF::CTeleIO stats1 = model.Execute("Compress=0&Seed=1&Statistics=Mean+SD+Min+Max+Q5+Q50+Q95", WGout);
+    WBSF::CTeleIO stats2 = model.Execute("Compress=0&Seed=1&Statistics=Mean+SD+Min+Max+Q5+Q50+Q95", WGout);
+    EXPECT_EQ(stats1.m_msg, "Success") << "Execute with statistics should return Success";
+    EXPECT_NE(stats1.m_data.find("_MEAN"), std::string::npos) << "Statistics should be in the header";
+    EXPECT_NE(stats1.m_data.find("_Q50"), std::string::npos) << "Quantiles should be in the header";
+    EXPECT_LT(stats1.m_data.size(), all.m_data.size()) << "Statistics should be smaller than all replications";
+    EXPECT_EQ(stats1.m_data, stats2.m_data) << "Statistics should be deterministic with a fixed seed";
+
+    WBSF::CTeleIO invalid = model.Execute("Compress=0&Statistics=Median", WGout);
+    EXPECT_NE(invalid.m_msg, "Success") << "Invalid statistic should return an error";
+  }
+
+  TEST(BioSIMCoreTests, Test26_Load_Weather_CSV)
+  {
+    // Here we test that the CSV weather parser gives the same results for compressed, uncompressed and CRLF data,
+    // the same results as the generic parser and that invalid values and dates return an error.
+    std::string options = "Normals=testData/Weather/Normals/World 1991-2020.NormalsDB.bin.gz";
+    WBSF::CWeatherGeneratorAPI weatherGen("");
+    std::string msg = weatherGen.Initialize(options);
+    EXPECT_EQ(msg, "Success") << "WeatherGenerator initialization should return Success";
+
+    WBSF::CModelExecutionAPI model("");
+    msg = model.Initialize("Model=DegreeDay(Annual).mdl");
+    EXPECT_EQ(msg, "Success") << "ModelExecutionAPI initialization should return Success";
+
+    options = "Latitude=47&Longitude=-70&Elevation=300&Variables=TN+T+TX+P&Source=FromNormals&NB_YEARS=2&Replications=5&Seed=1";
+    WBSF::CTeleIO WGcsv = weatherGen.Generate(options + "&Compress=0");
+    WBSF::CTeleIO WGcompressed = weatherGen.Generate(options + "&Compress=1");
+    EXPECT_EQ(WGcsv.m_msg, "Success") << "Generate should return Success";
+    EXPECT_EQ(WGcompressed.m_msg, "Success") << "Generate should return Success";
+
+    WBSF::CTeleIO WGcrlf = WGcsv;
+    WGcrlf.m_data.clear();
+    for (char c : WGcsv.m_data)
+    {
+      if (c == '\n')
+        WGcrlf.m_data += '\r';
+      WGcrlf.m_data += c;
+    }
+
+    WBSF::CTeleIO modelCsv = model.Execute("Compress=0&Seed=1", WGcsv);
+    WBSF::CTeleIO modelCompressed = model.Execute("Compress=0&Seed=1", WGcompressed);
+    WBSF::CTeleIO modelCrlf = model.Execute("Compress=0&Seed=1", WGcrlf);
+    EXPECT_EQ(modelCsv.m_msg, "Success") << "Execute should return Success";
+    EXPECT_EQ(modelCompressed.m_data, modelCsv.m_data) << "Compressed CSV weather should give the same results";
+    EXPECT_EQ(modelCrlf.m_data, modelCsv.m_data) << "CRLF CSV weather should give the same results";
+
+    WBSF::CTeleIO invalid = WGcsv;
+    invalid.m_data = invalid.m_data.substr(0, invalid.m_data.find('\n') + 1) + "2020,1,x,-10,-5,0,0\n";
+    WBSF::CTeleIO modelInvalid = model.Execute("Compress=0&Seed=1", invalid);
+    EXPECT_NE(modelInvalid.m_msg, "Success") << "Invalid weather value should return an error";
+
+    // an unknown column is only supported by the generic parser: both parsers must give the same weather
+    WBSF::CModelExecutionAPI modelDaily("");
+    msg = modelDaily.Initialize("Model=DegreeDay(Daily).mdl");
+    EXPECT_EQ(msg, "Success") << "ModelExecutionAPI initialization should return Success";
+
+    WBSF::CTeleIO WGgeneric = WGcsv;
+    WGgeneric.m_data.clear();
+    for (size_t pos = 0, eol = 0; pos < WGcsv.m_data.size(); pos = eol + 1)
+    {
+      eol = std::min(WGcsv.m_data.find('\n', pos), WGcsv.m_data.size());
+      std::string line = WGcsv.m_data.substr(pos, eol - pos);
+      if (!line.empty())
+        WGgeneric.m_data += line + (line.compare(0, 4, "Year") == 0 ? ",Extra" : ",0") + "\n";
+    }
+
+    WBSF::CTeleIO modelFast = modelDaily.Execute("Compress=0&Seed=1", WGcsv);
+    WBSF::CTeleIO modelGeneric = modelDaily.Execute("Compress=0&Seed=1", WGgeneric);
+    EXPECT_EQ(modelFast.m_msg, "Success") << "Execute should return Success";
+    EXPECT_EQ(modelGeneric.m_msg, "Success") << "Execute with the generic parser should return Success";
+    EXPECT_EQ(modelFast.m_data, modelGeneric.m_data) << "Fast and generic CSV parsers should give the same weather";
+
+    // dates out of range return an error instead of writing outside of the weather
+    size_t first = WGcsv.m_data.find('\n') + 1;
+    size_t second = WGcsv.m_data.find('\n', first) + 1;
+    std::string line = WGcsv.m_data.substr(second, WGcsv.m_data.find('\n', second) - second);
+    std::vector<std::string> fields;
+    for (size_t pos = 0, next = 0; pos <= line.size(); pos = next + 1)
+    {
+      next = std::min(line.find(',', pos), line.size());
+      fields.push_back(line.substr(pos, next - pos));
+    }
+
+    std::vector<std::pair<size_t, std::string>> invalidDates = { {1, "0"}, {1, "13"}, {2, "0"}, {2, "32"}, {0, "1900"}, {0, "3000"} };
+    for (const auto& date : invalidDates)
+    {
+      std::vector<std::string> invalidFields = fields;
+      invalidFields[date.first] = date.second;
+      std::string invalidLine;
+      for (size_t i = 0; i < invalidFields.size(); i++)
+        invalidLine += (i == 0 ? "" : ",") + invalidFields[i];
+
+      WBSF::CTeleIO invalidDate = WGcsv;
+      invalidDate.m_data.replace(second, line.size(), invalidLine);
+      EXPECT_NE(model.Execute("Compress=0&Seed=1", invalidDate).m_msg, "Success") << "Invalid date should return an error: " << invalidLine;
+    }
+
+    // compressed weather larger than one decompression chunk: replications and lines are split between chunks
+    std::string largeOptions = "Latitude=47&Longitude=-70&Elevation=300&Variables=TN+T+TX+P&Source=FromNormals&NB_YEARS=2&Replications=80&Seed=1";
+    WBSF::CTeleIO WGlargeCsv = weatherGen.Generate(largeOptions + "&Compress=0");
+    WBSF::CTeleIO WGlargeCompressed = weatherGen.Generate(largeOptions + "&Compress=1");
+    EXPECT_GT(WGlargeCsv.m_data.size(), 1024 * 1024) << "Weather should be larger than the decompression chunks";
+
+    WBSF::CTeleIO modelLargeCsv = modelDaily.Execute("Compress=0&Seed=1", WGlargeCsv);
+    WBSF::CTeleIO modelLargeCompressed = modelDaily.Execute("Compress=0&Seed=1", WGlargeCompressed);
+    EXPECT_EQ(modelLargeCsv.m_msg, "Success") << "Execute should return Success";
+    EXPECT_EQ(modelLargeCompressed.m_msg, "Success") << "Execute with compressed weather should return Success";
+    EXPECT_EQ(modelLargeCompressed.m_data, modelLargeCsv.m_data) << "Compressed weather read by chunks should give the same results";
+  }
+
+  TEST(BioSIMCoreTests, Test27_Execute_Input_View)
+  {
+    // Here we test that a non-owning view of the weather gives the same results and that CTeleIO moves without copy.
+    std::string options = "Normals=testData/Weather/Normals/World 1991-2020.NormalsDB.bin.gz";
+    WBSF::CWeatherGeneratorAPI weatherGen("");
+    std::string msg = weatherGen.Initialize(options);
+    EXPECT_EQ(msg, "Success") << "WeatherGenerator initialization should return Success";
+
+    WBSF::CModelExecutionAPI model("");
+    msg = model.Initialize("Model=DegreeDay(Annual).mdl");
+    EXPECT_EQ(msg, "Success") << "ModelExecutionAPI initialization should return Success";
+
+    options = "Latitude=47&Longitude=-70&Elevation=300&Variables=TN+T+TX+P&Source=FromNormals&NB_YEARS=2&Replications=5&Seed=1&Compress=1";
+    WBSF::CTeleIO WGout = weatherGen.Generate(options);
+    EXPECT_EQ(WGout.m_msg, "Success") << "Generate should return Success";
+
+    // caller buffer, as given from another language
+    std::vector<char> buffer(WGout.m_data.begin(), WGout.m_data.end());
+    WBSF::CTeleIOView view(WGout.m_compress, WGout.m_metadata, buffer.data(), buffer.size());
+
+    WBSF::CTeleIO modelOut = model.Execute("Compress=0&Seed=1", WGout);
+    WBSF::CTeleIO modelView = model.Execute("Compress=0&Seed=1", view);
+    EXPECT_EQ(modelOut.m_msg, "Success") << "Execute should return Success";
+    EXPECT_TRUE(modelView == modelOut) << "Execute of a view should give the same results";
+
+    static_assert(std::is_nothrow_move_constructible<WBSF::CTeleIO>::value, "CTeleIO should be movable");
+    const char* pData = modelView.m_data.data();
+    WBSF::CTeleIO moved = std::move(modelView);
+    EXPECT_EQ(moved.m_data.data(), pData) << "Moving CTeleIO should not copy the data";
+  }
+
+  TEST(BioSIMCoreTests, Test28_Model_Cache)
+  {
+    // Here we test that a deterministic execution on the same weather is returned from the cache,
+    // also when the weather is generated again, comes from the weather generator cache or from another instance.
+    std::string options = "Normals=testData/Weather/Normals/World 1991-2020.NormalsDB.bin.gz";
+    WBSF::CWeatherGeneratorAPI weatherGen("");
+    std::string msg = weatherGen.Initialize(options + "&CacheSize=10");
+    EXPECT_EQ(msg, "Success") << "WeatherGenerator initialization should return Success";
+
+    WBSF::CWeatherGeneratorAPI weatherGen2("");
+    msg = weatherGen2.Initialize(options);
+    EXPECT_EQ(msg, "Success") << "WeatherGenerator initialization should return Success";
+
+    WBSF::CModelExecutionAPI model("");
+    msg = model.Initialize("Model=DegreeDay(Annual).mdl&CacheSize=10");
+    EXPECT_EQ(msg, "Success") << "ModelExecutionAPI initialization should return Success";
+
+    options = "Latitude=47&Longitude=-70&Elevation=300&compress=0&Variables=TN+T+TX+P&Source=FromNormals&NB_YEARS=2&Replications=2&Seed=1";
+    WBSF::CTeleIO WGout = weatherGen.Generate(options);
+    WBSF::CTeleIO WGcached = weatherGen.Generate(options);
+    WBSF::CTeleIO WGother = weatherGen2.Generate(options);
+    EXPECT_EQ(WGout.m_msg, "Success") << "Generate should return Success";
+    EXPECT_EQ(WGother.m_msg, "Success") << "Generate should return Success";
+
+    WBSF::CTeleIO modelOut1 = model.Execute("Compress=0&Seed=1", WGout);
+    WBSF::CTeleIO modelOut2 = model.Execute("seed=1&compress=0", WGcached);
+    WBSF::CTeleIO modelOut3 = model.Execute("Compress=0&Seed=1", WGother);
+    EXPECT_EQ(modelOut1.m_msg, "Success") << "Execute should return Success";
+    EXPECT_TRUE(modelOut1 == modelOut2) << "Cached output should be the same";
+    EXPECT_TRUE(modelOut1 == modelOut3) << "Cached output should be the same";
+    EXPECT_EQ(model.GetCacheMisses(), 1) << "First execution should be a cache miss";
+    EXPECT_EQ(model.GetCacheHits(), 2) << "Same weather from the weather generator cache or another instance should be a cache hit";
+
+    // same weather compressed: same content, same cache entry
+    WBSF::CTeleIO WGcompressed = weatherGen2.Generate("Latitude=47&Longitude=-70&Elevation=300&compress=1&Variables=TN+T+TX+P&Source=FromNormals&NB_YEARS=2&Replications=2&Seed=1");
+    EXPECT_EQ(WGcompressed.m_msg, "Success") << "Generate should return Success";
+    EXPECT_NE(WGcompressed.m_data, WGout.m_data) << "Weather should be compressed";
+    WBSF::CTeleIO modelOutCompressed = model.Execute("Compress=0&Seed=1", WGcompressed);
+    EXPECT_TRUE(modelOut1 == modelOutCompressed) << "Cached output should be the same";
+    EXPECT_EQ(model.GetCacheHits(), 3) << "Same weather compressed should be a cache hit";
+
+    // other weather: not in the cache
+    WBSF::CTeleIO WGseed2 = weatherGen.Generate("Latitude=47&Longitude=-70&Elevation=300&compress=0&Variables=TN+T+TX+P&Source=FromNormals&NB_YEARS=2&Replications=2&Seed=2");
+    WBSF::CTeleIO modelOut4 = model.Execute("Compress=0&Seed=1", WGseed2);
+    EXPECT_EQ(modelOut4.m_msg, "Success") << "Execute should return Success";
+    EXPECT_EQ(model.GetCacheMisses(), 2) << "Other weather should be a cache miss";
+
+    // other seed: not in the cache
+    WBSF::CTeleIO modelOut5 = model.Execute("Compress=0&Seed=2", WGout);
+    EXPECT_EQ(modelOut5.m_msg, "Success") << "Execute should return Success";
+    EXPECT_EQ(model.GetCacheMisses(), 3) << "Other seed should be a cache miss";
+  }
+
+  TEST(BioSIMCoreTests, Test29_WeatherGenerator_GenerateStream_Incremental)
+  {
+    // Here we test that each replication reaches the sink as soon as it is written, also when compressed.
+    std::string options = "Normals=testData/Weather/Normals/World 1991-2020.NormalsDB.bin.gz";
+    WBSF::CWeatherGeneratorAPI weatherGen("");
+    std::string msg = weatherGen.Initialize(options + "&NbCPU=0");
+    EXPECT_EQ(msg, "Success") << "WeatherGenerator initialization should return Success";
+
+    WBSF::CModelExecutionAPI model("");
+    msg = model.Initialize("Model=DegreeDay(Annual).mdl");
+    EXPECT_EQ(msg, "Success") << "ModelExecutionAPI initialization should return Success";
+
+    const size_t nbReplications = 8;
+    options = "Latitude=47&Longitude=-70&Elevation=300&Variables=TN+T+TX+P&Source=FromNormals&NB_YEARS=2&Replications=" + std::to_string(nbReplications) + "&Seed=1";
+    WBSF::CTeleIO WGout = weatherGen.Generate(options + "&Compress=0");
+    EXPECT_EQ(WGout.m_msg, "Success") << "Generate should return Success";
+
+    std::vector<std::string> chunks;
+    WBSF::CTeleIO WGstream = weatherGen.GenerateStream(options + "&Compress=0", [&](const std::string& chunk) { chunks.push_back(chunk); });
+    EXPECT_EQ(WGstream.m_msg, "Success") << "GenerateStream should return Success";
+    EXPECT_GE(chunks.size(), nbReplications) << "Each replication should be sent before the next ones are written";
+
+    std::string data;
+    for (const auto& chunk : chunks)
+      data += chunk;
+    EXPECT_EQ(data, WGout.m_data) << "Replications should be streamed in order";
+
+    chunks.clear();
+    WGstream = weatherGen.GenerateStream(options + "&Compress=1", [&](const std::string& chunk) { chunks.push_back(chunk); });
+    EXPECT_EQ(WGstream.m_msg, "Success") << "GenerateStream should return Success";
+    EXPECT_GE(chunks.size(), nbReplications) << "Compressed replications should also be sent before the next ones are written";
+    ASSERT_FALSE(chunks.empty());
+
+    // the first chunk is usable alone: the caller can start before the end of the generation
+    EXPECT_EQ(WGstream.m_metadata, WGout.m_metadata) << "GenerateStream should return the location in the metadata";
+    WBSF::CTeleIO first(true, "", "", WGstream.m_metadata, chunks.front());
+    WBSF::CTeleIO modelFirst = model.Execute("Compress=0&Seed=1", first);
+    EXPECT_EQ(modelFirst.m_msg, "Success") << "First compressed chunk should be a complete gzip member";
+
+    WBSF::CTeleIO WGcompressed(true, "", "", WGstream.m_metadata, "");
+    for (const auto& chunk : chunks)
+      WGcompressed.m_data += chunk;
+
+    WBSF::CTeleIO modelCsv = model.Execute("Compress=0&Seed=1", WGout);
+    WBSF::CTeleIO modelCompressed = model.Execute("Compress=0&Seed=1", WGcompressed);
+    EXPECT_EQ(modelCsv.m_msg, "Success") << "Execute should return Success";
+    EXPECT_EQ(modelCompressed.m_data, modelCsv.m_data) << "Concatenated gzip members should give the same weather";
+  }
+
+  TEST(BioSIMCoreTests, Test30_WeatherGenerator_Concurrent_Generate_Disk_Database)
+  {
+    // Here we test that concurrent calls on a daily database read from disk (.DailyDB) give the same results as a serial call.
+    std::string options = "Normals=testData/Weather/Normals/World 1991-2020.NormalsDB.bin.gz&Daily=testData/Weather/Daily/Demo 2005-2010.DailyDB";
+    WBSF::CWeatherGeneratorAPI weatherGen("");
+    std::string msg = weatherGen.Initialize(options + "&NbCPU=0");
+    EXPECT_EQ(msg, "Success") << "WeatherGenerator initialization should return Success";
+
+    options = "compress=0&Variables=TN+T+TX+P&Source=FromObservation&First_year=2006&Last_year=2008&Replications=2&Seed=1";
+    std::vector<std::string> locations = { "&Latitude=47&Longitude=-70&Elevation=300", "&Latitude=46.5&Longitude=-71&Elevation=200", "&Latitude=45.5&Longitude=-73.5&Elevation=50", "&Latitude=46&Longitude=-72&Elevation=100" };
+
+    std::vector<WBSF::CTeleIO> WGref;
+    for (const auto& location : locations)
+    {
+      WGref.push_back(weatherGen.Generate(options + location));
+      EXPECT_EQ(WGref.back().m_msg, "Success") << "Generate should return Success";
+    }
+
+    std::vector<WBSF::CTeleIO> WGout(4 * locations.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < WGout.size(); i++)
+      threads.emplace_back([&, i]() { WGout[i] = weatherGen.Generate(options + locations[i % locations.size()]); });
+
+    for (size_t i = 0; i < threads.size(); i++)
+      threads[i].join();
+
+    for (size_t i = 0; i < WGout.size(); i++)
+    {
+      EXPECT_EQ(WGout[i].m_msg, "Success") << "Generate should return Success";
+      EXPECT_TRUE(WGout[i] == WGref[i % locations.size()]) << "Concurrent WG outputs should be the same as the serial output";
+    }
+
+    std::string batch = "[{\"Latitude\":47,\"Longitude\":-70,\"Elevation\":300},{\"Latitude\":46.5,\"Longitude\":-71,\"Elevation\":200},{\"Latitude\":45.5,\"Longitude\":-73.5,\"Elevation\":50},{\"Latitude\":46,\"Longitude\":-72,\"Elevation\":100}]";
+    WBSF::CTeleIO WGbatch = weatherGen.GenerateBatch(options, batch);
+    EXPECT_EQ(WGbatch.m_msg, "Success") << "GenerateBatch should return Success";
+  }
+
 }
 
@@ -13,10 +13,24 @@ namespace BioSIM_APITest
   BioSIM_ModelTest() : m_WeatherGen("") {}
 
   protected:
+    static constexpr const char* WG_OPTIONS = "Normals=testData/Weather/Normals/World 1991-2020.NormalsDB.bin.gz&Daily=testData/Weather/Daily/Demo 2008-2010.DailyDB.bin.gz";
+
+    // keep the databases loaded for the whole suite: each test reuses them instead of reloading
+    static void SetUpTestSuite()
+    {
+      s_pSharedWeatherGen = std::make_unique<WBSF::CWeatherGeneratorAPI>("");
+      std::string msg = s_pSharedWeatherGen->Initialize(WG_OPTIONS);
+      ASSERT_EQ(msg, "Success") << "Shared WeatherGeneratorAPI initialization should return Success";
+    }
+
+    static void TearDownTestSuite()
+    {
+      s_pSharedWeatherGen.reset();
+    }
+
     void SetUp() override
     {
-      std::string options = "Normals=testData/Weather/Normals/World 1991-2020.NormalsDB.bin.gz&Daily=testData/Weather/Daily/Demo 2008-2010.DailyDB.bin.gz";
-      std::string msg = m_WeatherGen.Initialize(options);
+      std::string msg = m_WeatherGen.Initialize(WG_OPTIONS);
       EXPECT_EQ(msg, "Success") << "WeatherGeneratorAPI initialization should return Success";
     }
 
@@ -44,8 +58,11 @@ namespace BioSIM_APITest
     }
 
     WBSF::CWeatherGeneratorAPI m_WeatherGen;
+    static std::unique_ptr<WBSF::CWeatherGeneratorAPI> s_pSharedWeatherGen;
   };
 
+  std::unique_ptr<WBSF::CWeatherGeneratorAPI> BioSIM_ModelTest::s_pSharedWeatherGen;
+
   TEST_F(BioSIM_ModelTest, Test01_ASCE_ETc_Daily)
   {
     ExecuteModel("ASCE-ETc(Daily).mdl");
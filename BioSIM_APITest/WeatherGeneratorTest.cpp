@@ -0,0 +1,185 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <boost/iostreams/filtering_streambuf.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+
+#include "Basic/nlohmann/json.hpp"
+#include "BioSIM_APITest.h"
+
+using namespace std;
+
+namespace BioSIM_APITest
+{
+  // The WeatherGenerator command line is run in its own process, from the test directory (testData is copied there).
+  static const std::string WG_LOCATIONS = "[{lat:47,lon:-70,alt:300},{lat:46.5,lon:-71,alt:200},{lat:45.5,lon:-73.5,alt:50},{lat:48,lon:-69,alt:150},{lat:46,lon:-72,alt:100},{lat:47.5,lon:-71.5,alt:400},{lat:45,lon:-74,alt:80},{lat:46.8,lon:-70.5,alt:250}]";
+  static const std::string WG_ARGS = "-g \"Shore=testData/Layers/Shore.ann\" -s FromObservations -N \"testData/Weather/Normals/World 1991-2020.NormalsDB.bin.gz\" -D \"testData/Weather/Daily/Demo 2005-2010.DailyDB\" -y \"2008 2010\" -r 2 -S 1 -l \"" + WG_LOCATIONS + "\"";
+
+  static int RunWeatherGenerator(const std::string& args)
+  {
+    std::string command = std::string("\"") + WEATHER_GENERATOR_EXE + "\" " + args;
+#if defined(_WIN32) || defined(_WIN64)
+    command = "\"" + command + "\"";  // cmd.exe removes the outer quotes
+#endif
+    return std::system(command.c_str());
+  }
+
+  static std::string ReadFile(const std::string& file_path)
+  {
+    std::ifstream file(file_path, std::ios::binary);
+    std::stringstream data;
+    data << file.rdbuf();
+    return data.str();
+  }
+
+  // decompress all members of a gzip file
+  static std::string Decompress(const std::string& compressed)
+  {
+    std::string data;
+    boost::iostreams::filtering_istreambuf in;
+    in.push(boost::iostreams::gzip_decompressor());
+    in.push(boost::iostreams::array_source(compressed.data(), compressed.size()));
+    boost::iostreams::copy(in, boost::iostreams::back_inserter(data));
+    return data;
+  }
+
+  static std::string GetTempFilePath(const std::string& name)
+  {
+    std::filesystem::path file_path = std::filesystem::temp_directory_path() / ("WeatherGeneratorTest_" + name);
+    std::filesystem::remove(file_path);
+    return file_path.string();
+  }
+
+  TEST(WeatherGeneratorTests, Test01_Multi_Threads)
+  {
+    // Here we test that locations generated in parallel (-M), each thread with its own daily database, give the same output as the serial run.
+    std::string serial = GetTempFilePath("serial.csv");
+    std::string parallel = GetTempFilePath("parallel.csv");
+
+    EXPECT_EQ(RunWeatherGenerator(WG_ARGS + " \"" + serial + "\""), 0) << "Serial run should succeed";
+    EXPECT_EQ(RunWeatherGenerator(WG_ARGS + " -M -C 0 \"" + parallel + "\""), 0) << "Parallel run should succeed";
+
+    std::string serialData = ReadFile(serial);
+    EXPECT_FALSE(serialData.empty()) << "Serial run should write the output";
+    EXPECT_EQ(ReadFile(parallel), serialData) << "Parallel output should be byte-identical to the serial output";
+  }
+
+  TEST(WeatherGeneratorTests, Test02_Failed_Run_Keep_Output)
+  {
+    // Here we test that a run that fails during the generation leaves the previous output unchanged and no partial file.
+    std::string output = GetTempFilePath("failed.csv");
+    EXPECT_EQ(RunWeatherGenerator(WG_ARGS + " \"" + output + "\""), 0) << "Run should succeed";
+    std::string data = ReadFile(output);
+    EXPECT_FALSE(data.empty()) << "Run should write the output";
+
+    // no observations in 1900
+    std::string failedArgs = WG_ARGS;
+    failedArgs.replace(failedArgs.find("-y \"2008 2010\""), 14, "-y \"1900 1900\" -m");
+    EXPECT_NE(RunWeatherGenerator(failedArgs + " \"" + output + "\""), 0) << "Run without observations should fail";
+    EXPECT_EQ(ReadFile(output), data) << "Failed run should not change the output";
+    EXPECT_FALSE(std::filesystem::exists(output + ".part")) << "Failed run without checkpoint should not leave a partial file";
+  }
+
+  TEST(WeatherGeneratorTests, Test03_Compress_Round_Trip)
+  {
+    // Here we test that the multi-member gzip output, serial or parallel, decompress to the uncompressed output.
+    std::string uncompressed = GetTempFilePath("uncompressed.csv");
+    std::string compressed = GetTempFilePath("compressed.csv.gz");
+    std::string compressedParallel = GetTempFilePath("compressed_parallel.csv.gz");
+
+    EXPECT_EQ(RunWeatherGenerator(WG_ARGS + " \"" + uncompressed + "\""), 0) << "Uncompressed run should succeed";
+    EXPECT_EQ(RunWeatherGenerator(WG_ARGS + " -c 6 \"" + compressed + "\""), 0) << "Compressed run should succeed";
+    EXPECT_EQ(RunWeatherGenerator(WG_ARGS + " -c 6 -M -C 0 \"" + compressedParallel + "\""), 0) << "Compressed parallel run should succeed";
+
+    std::string data = ReadFile(uncompressed);
+    std::string gzip = ReadFile(compressed);
+    EXPECT_FALSE(data.empty()) << "Run should write the output";
+    ASSERT_GE(gzip.size(), 2);
+    EXPECT_EQ(gzip.substr(0, 2), "\x1f\x8b") << "Compressed output should be gzip";
+    EXPECT_LT(gzip.size(), data.size()) << "Compressed output should be smaller";
+    EXPECT_EQ(Decompress(gzip), data) << "Decompressed output should be the same as the uncompressed run";
+    EXPECT_EQ(ReadFile(compressedParallel), gzip) << "Compressed output should be the same whatever the number of threads";
+  }
+
+  TEST(WeatherGeneratorTests, Test04_Shards_Merge)
+  {
+    // Here we test that merged shards are the same as the complete run and that the merge validates the shards.
+    std::string complete = GetTempFilePath("complete.csv");
+    EXPECT_EQ(RunWeatherGenerator(WG_ARGS + " \"" + complete + "\""), 0) << "Complete run should succeed";
+
+    std::vector<std::string> shards;
+    for (size_t i = 1; i <= 3; i++)
+    {
+      shards.push_back(GetTempFilePath("shard" + std::to_string(i) + ".csv"));
+      EXPECT_EQ(RunWeatherGenerator(WG_ARGS + " -p " + std::to_string(i) + "/3 \"" + shards.back() + "\""), 0) << "Shard run should succeed";
+      EXPECT_TRUE(std::filesystem::exists(shards.back() + ".shard")) << "Shard run should write the shard metadata";
+    }
+
+    auto merge = [](const std::vector<std::string>& files, const std::string& output)
+    {
+      std::string args = "-a";
+      for (const auto& file : files)
+        args += " \"" + file + "\"";
+      return RunWeatherGenerator(args + " \"" + output + "\"");
+    };
+
+    std::string merged = GetTempFilePath("merged.csv");
+    EXPECT_EQ(merge(shards, merged), 0) << "Merge should succeed";
+    EXPECT_EQ(ReadFile(merged), ReadFile(complete)) << "Merged shards should be the same as the complete run";
+
+    std::string invalid = GetTempFilePath("invalid.csv");
+    EXPECT_NE(merge({ shards[1], shards[0], shards[2] }, invalid), 0) << "Shards out of order should not be merged";
+    EXPECT_NE(merge({ shards[0], shards[1] }, invalid), 0) << "Missing shard should not be merged";
+
+    std::string otherSeed = GetTempFilePath("other_seed.csv");
+    std::string otherArgs = WG_ARGS;
+    otherArgs.replace(otherArgs.find("-S 1"), 4, "-S 2");
+    EXPECT_EQ(RunWeatherGenerator(otherArgs + " -p 2/3 \"" + otherSeed + "\""), 0) << "Shard run should succeed";
+    EXPECT_NE(merge({ shards[0], otherSeed, shards[2] }, invalid), 0) << "Shards with another seed should not be merged";
+
+    std::string badShard = GetTempFilePath("bad_shard.csv");
+    EXPECT_NE(RunWeatherGenerator(WG_ARGS + " -p 2x/3 \"" + badShard + "\""), 0) << "Invalid shard should return an error";
+  }
+
+  TEST(WeatherGeneratorTests, Test05_Resume)
+  {
+    // Here we test that a run resumed from a checkpoint skips the completed locations, removes the data written after
+    // the checkpoint and gives the same output as the complete run. The interrupted run is made from the first shard.
+    std::string complete = GetTempFilePath("resume_complete.csv");
+    std::string shard = GetTempFilePath("resume_shard.csv");
+    EXPECT_EQ(RunWeatherGenerator(WG_ARGS + " \"" + complete + "\""), 0) << "Complete run should succeed";
+    EXPECT_EQ(RunWeatherGenerator(WG_ARGS + " -p 1/2 \"" + shard + "\""), 0) << "Shard run should succeed";
+
+    nlohmann::json checkpoint = nlohmann::json::parse(ReadFile(shard + ".shard"));
+    checkpoint["Next"] = checkpoint["Last"];
+    checkpoint["First"] = 0;
+    checkpoint["Last"] = checkpoint["Locations"];
+    checkpoint.erase("Shard");
+    checkpoint.erase("NbShards");
+    std::string shardData = ReadFile(shard);
+    checkpoint["Size"] = shardData.size();
+
+    std::string resumed = GetTempFilePath("resume.csv");
+    std::filesystem::remove(resumed + ".checkpoint");
+    std::ofstream(resumed + ".checkpoint", std::ios::binary) << checkpoint.dump();
+    std::ofstream(resumed + ".part", std::ios::binary) << shardData << "data written after the checkpoint";
+
+    std::string seed0Args = WG_ARGS;
+    seed0Args.replace(seed0Args.find("-S 1"), 4, "-S 0");
+    EXPECT_NE(RunWeatherGenerator(seed0Args + " -R \"" + resumed + "\""), 0) << "Resume with a random seed should fail";
+    EXPECT_TRUE(std::filesystem::exists(resumed + ".checkpoint")) << "Failed resume should keep the checkpoint";
+
+    EXPECT_EQ(RunWeatherGenerator(WG_ARGS + " -R \"" + resumed + "\""), 0) << "Resumed run should succeed";
+    std::string data = ReadFile(complete);
+    EXPECT_FALSE(data.empty()) << "Run should write the output";
+    EXPECT_EQ(ReadFile(resumed), data) << "Resumed output should be the same as the complete run";
+    EXPECT_FALSE(std::filesystem::exists(resumed + ".checkpoint")) << "Completed run should remove the checkpoint";
+    EXPECT_FALSE(std::filesystem::exists(resumed + ".part")) << "Completed run should not leave a partial file";
+  }
+
+}
@@ -9,6 +9,13 @@
 #include <array>
 #include <utility>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <filesystem>
+#include <charconv>
 
 #include <boost/timer/timer.hpp>
 #include <boost/filesystem.hpp>
@@ -17,6 +24,8 @@
 #include <boost/iostreams/filtering_streambuf.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
 #include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
 
 
 #include "Basic/nlohmann/json.hpp"
@@ -232,7 +241,7 @@ namespace WBSF
 			//me["Format"].reset(new ValueArg<string>("F", "Format", "Output format type: CSV or JSON. CSV by default", false, "CSV", &format_type));
 			//cmd.add(*me["Format"]);
 
-			me["Compress"].reset(new ValueArg<int>("c", "Compress", "Output file is compressed", false, -1, ""));
+			me["Compress"].reset(new ValueArg<int>("c", "Compress", "Output file is compressed (multi-member gzip). Compression level 1-9, 0 = no compression, other values = default level", false, -1, ""));
 			cmd.add(*me["Compress"]);
 
 			me["Verbose"].reset(new ValueArg<std::string>("b", "verbose", "verbose", false, "", ""));
@@ -325,6 +334,17 @@ namespace WBSF
 			cmd.add(*me["Output"]);
 
 
+			//Sharding
+			me["Shard"].reset(new ValueArg<string>("p", "Shard", "Generate only the shard i of N (1-based) of the locations list, for example \"2/4\". Locations are split in contiguous blocks and seeds are the same as the complete run.", false, "", "i/N"));
+			cmd.add(*me["Shard"]);
+			me["Merge"].reset(new SwitchArg("a", "Merge", "Merge shards output files, given in shard order, into the last file. The result is the same as the complete run. Each shard must have the metadata written by -p (output file + \".shard\"): all shards of the same run, with the same seed and options, must be given in order.", false));
+			cmd.add(*me["Merge"]);
+
+			//Checkpoint
+			me["Resume"].reset(new SwitchArg("R", "Resume", "Resume an interrupted run from the checkpoint file of the output (output file + \".checkpoint\"). Completed locations are skipped and the others are appended to the partial output (output file + \".part\"). Start from the beginning if there is no checkpoint. Need a fixed seed (-S).", false));
+			cmd.add(*me["Resume"]);
+
+
 			//Input/Output
 			me["Files"].reset(new UnlabeledMultiArg<string>("IOFiles", "Input and output files. Only output file if -loc option is specify. Input can be in CSV or JSON format. 2 output files will be is generated: one for metadata and one for data. Extension of data file is set from output type and compress flag", true, "Input/Output files"));
 			cmd.add(*me["Files"]);
@@ -430,6 +450,52 @@ namespace WBSF
 		return msg;
 	}
 
+	//shard i of N, 1 of 1 when not set. Both numbers must be complete integers: "2x/4" is invalid
+	ERMsg CWeatherGeneratorOption::GetShard(size_t& i, size_t& N)const
+	{
+		ERMsg msg;
+
+		i = 1;
+		N = 1;
+
+		if (at("Shard")->isSet())
+		{
+			string shard = Get<string>("Shard");
+			string::size_type pos = shard.find('/');
+
+			auto to_size_t = [](const string& str, size_t& value)
+			{
+				auto result = std::from_chars(str.data(), str.data() + str.size(), value);
+				return !str.empty() && result.ec == std::errc() && result.ptr == str.data() + str.size();
+			};
+
+			if (pos == string::npos || !to_size_t(shard.substr(0, pos), i) || !to_size_t(shard.substr(pos + 1), N) || N < 1 || i < 1 || i > N)
+				msg.ajoute("Invalid shard " + shard + ". Shard must be i/N with 1 <= i <= N.");
+		}
+
+		return msg;
+	}
+
+	ERMsg CWeatherGeneratorOption::GetShard(size_t nb_locations, size_t& first, size_t& last)const
+	{
+		ERMsg msg;
+
+		first = 0;
+		last = nb_locations;
+
+		size_t i = 1;
+		size_t N = 1;
+		msg = GetShard(i, N);
+		if (msg)
+		{
+			//contiguous blocks: merged shards are in the same order as the complete run
+			first = nb_locations * (i - 1) / N;
+			last = nb_locations * i / N;
+		}
+
+		return msg;
+	}
+
 	ERMsg CWeatherGeneratorOption::GetWGInput(const CGlobalData& global, CWGInput& WGInput)const
 	{
 		ERMsg msg;
@@ -510,6 +576,170 @@ namespace WBSF
 
 	//************************************************************************************************************************
 
+	//Write the data of each location in the order of locations, as soon as it and all previous locations are done.
+	//Threads too far ahead of the first unwritten location wait, so memory stay bounded by the window.
+	//The checkpoint function is called periodically, when new locations were written, with the number of locations written.
+	class COrderedWriter
+	{
+	public:
+
+		COrderedWriter(std::ostream& out, size_t window, const std::function<void(size_t nb_written)>& checkpoint = nullptr, std::chrono::seconds interval = std::chrono::seconds(60)) :
+			m_out(out),
+			m_window(max(size_t(1), window)),
+			m_next(0),
+			m_bAbort(false),
+			m_checkpoint(checkpoint),
+			m_interval(interval),
+			m_last_checkpoint(std::chrono::steady_clock::now()),
+			m_last_next(0)
+		{
+		}
+
+		//wait until location l is inside the window. Return false if writing was aborted
+		bool wait(size_t l)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cv.wait(lock, [&]() { return m_bAbort || l < m_next + m_window; });
+
+			return !m_bAbort;
+		}
+
+		void write(size_t l, std::string data)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			m_pending[l] = std::move(data);
+			while (!m_pending.empty() && m_pending.begin()->first == m_next)
+			{
+				m_out << m_pending.begin()->second;
+				m_pending.erase(m_pending.begin());
+				m_next++;
+			}
+
+			if (m_checkpoint && m_next > m_last_next && std::chrono::steady_clock::now() - m_last_checkpoint >= m_interval)
+			{
+				m_checkpoint(m_next);
+				m_last_checkpoint = std::chrono::steady_clock::now();
+				m_last_next = m_next;
+			}
+
+			m_cv.notify_all();
+		}
+
+		//stop after an error: waiting threads are released
+		void abort()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_bAbort = true;
+			m_cv.notify_all();
+		}
+
+	protected:
+
+		std::ostream& m_out;
+		size_t m_window;
+		size_t m_next;
+		bool m_bAbort;
+		std::map<size_t, std::string> m_pending;
+		std::mutex m_mutex;
+		std::condition_variable m_cv;
+
+		std::function<void(size_t nb_written)> m_checkpoint;
+		std::chrono::seconds m_interval;
+		std::chrono::steady_clock::time_point m_last_checkpoint;
+		size_t m_last_next;
+	};
+
+
+	//options that change the generated data. Shards and checkpoints are only valid for the same options
+	static nlohmann::json GetRunOptions(const CWeatherGeneratorOption& options)
+	{
+		nlohmann::json run;
+		for (const char* name : { "Source", "NormalsDB", "DailyDB", "HourlyDB", "Input", "Output", "Variables", "Models" })
+			run[name] = options.Get<string>(name);
+
+		for (const char* name : { "NbYears", "nNormals", "nObserved", "Reps" })
+			run[name] = options.Get<int>(name);
+
+		for (const char* name : { "NoForecast", "NoExposure", "NoFillMissing", "IgnoreNearest" })
+			run[name] = options.at(name)->isSet();
+
+		const auto& years = options.Get<Array<int, 2>>("Years");
+		run["Years"] = { years[0], years[1] };
+
+		return run;
+	}
+
+	//Checkpoint: the next location to generate and the output size when all previous locations are written.
+	//Checkpoints and shards metadata are written in a temporary file and renamed, so they are never partially written.
+	static ERMsg SaveJSON(const std::string& file_path, const nlohmann::json& json)
+	{
+		ERMsg msg;
+
+		WBSF::ofStream file;
+		msg = file.open(file_path + ".tmp");
+		if (msg)
+		{
+			file << json.dump();
+			file.close();
+
+			std::error_code ec;
+			std::filesystem::rename(file_path + ".tmp", file_path, ec);
+			if (ec)
+				msg.ajoute("Unable to save " + file_path + ": " + ec.message());
+		}
+
+		return msg;
+	}
+
+	//load the checkpoint of a previous run. Locations, shard and options must be the same
+	static ERMsg LoadCheckpoint(const std::string& file_path, const nlohmann::json& current, size_t& next, size_t& size)
+	{
+		ERMsg msg;
+
+		WBSF::ifStream file;
+		msg = file.open(file_path);
+		if (msg)
+		{
+			nlohmann::json checkpoint = nlohmann::json::parse(file, nullptr, false);
+			file.close();
+
+			if (checkpoint.is_object() && checkpoint.contains("Next") && checkpoint.contains("Size"))
+			{
+				for (const char* key : { "Locations", "First", "Last", "Seed", "Compress", "Options" })
+				{
+					if (checkpoint.value(key, nlohmann::json()) != current[key])
+						msg.ajoute(string("Checkpoint ") + key + " doesn't match the current run: " + checkpoint.value(key, nlohmann::json()).dump() + " vs " + current[key].dump());
+				}
+
+				next = checkpoint["Next"];
+				size = checkpoint["Size"];
+			}
+			else
+			{
+				msg.ajoute("Invalid checkpoint file: " + file_path);
+			}
+		}
+
+		return msg;
+	}
+
+
+	//Compress data in an independent gzip member. Members are compressed in parallel and concatenated 
+	//in a standard multi-member gzip file, readable by gzip, zcat and boost.
+	static std::string GetGZipMember(const std::string& data, const boost::iostreams::gzip_params& p)
+	{
+		std::string compressed;
+
+		boost::iostreams::filtering_ostream out;
+		out.push(boost::iostreams::gzip_compressor(p));
+		out.push(boost::iostreams::back_inserter(compressed));
+		out.write(data.data(), data.size());
+		out.reset();//flush and write the gzip footer
+
+		return compressed;
+	}
+
 
 	ERMsg CWeatherGeneratorApp::Execute()
 	{
@@ -517,6 +747,10 @@ namespace WBSF
 
 
 
+		//merge shards output files, no generation
+		if (m_options.at("Merge")->isSet())
+			return MergeShards();
+
 		boost::timer::cpu_timer timer;
 		timer.start();
 
@@ -541,9 +775,10 @@ namespace WBSF
 			CLocationVector locations;
 			msg += m_options.GetLoc(m_global, locations);
 
-			//init WG
-			CWeatherGeneratorPtr pWG;
-			msg += InitializeWG(pWG);
+			//init one WG per thread
+			int CPU = GetNbCPU();
+			vector<CWeatherGeneratorPtr> WGs;
+			msg += InitializeWG(WGs, size_t(CPU));
 
 			if (msg)
 			{
@@ -554,93 +789,181 @@ namespace WBSF
 					//CLocation location;// (options.m_name, options.m_ID, options.m_latitude, options.m_longitude, options.m_elevation);
 
 
-					CCallback callback;
-
 					//init random generator
 					CRandomGenerator rand(m_options.Get<int>("Seed"));
 
-					//init output memory
-					deque < deque < CSimulationPoint>> weather(locations.size());
-
-					//init each seed for each locations;
+					//init each seed for each locations: seeds depend only on the global seed and 
+					//the location index, so a shard use the same seeds as the complete run
 					vector<unsigned long> seeds(locations.size());
 					for (size_t l = 0; l < locations.size(); l++)
-					{
 						seeds[l] = 1 + rand.Rand();
-						weather[l].resize(pWG->GetNbReplications());
-					}
 
-					
-					
-					// 
-					//					omp_set_nested(1);//for inner parallel loop
-					bool bMulti = m_options["Multi"]->isSet();
-					int CPU = min(m_options.Get<int>("CPU"), omp_get_max_threads());
-					if (CPU == 0)
-						CPU = omp_get_max_threads();
-					else if (CPU < 0)
-						CPU = max(1, omp_get_max_threads() - CPU);
-
-					//de
-//#pragma omp parallel for schedule(static, 1) num_threads( CPU ) if (bMulti)
-					for (size_t l = 0; l < locations.size()&&msg; l++)
+					//locations of this shard
+					size_t first = 0;
+					size_t last = locations.size();
+					msg += m_options.GetShard(locations.size(), first, last);
+
+					string output_file_path = m_options.GetFilesArg().back();
+
+					//compression level 1 to 9, default level otherwise
+					bool bCompress = m_options["Compress"]->isSet() && m_options.Get<int>("Compress") != 0;
+					int level = m_options.Get<int>("Compress");
+					boost::iostreams::gzip_params p(level >= 1 && level <= 9 ? level : boost::iostreams::gzip::default_compression);
+
+					//data are written in a partial file, renamed to the output file when the run is complete:
+					//a failed run never leaves an incomplete output file
+					string part_file_path = output_file_path + ".part";
+
+					//checkpoint of this run
+					string checkpoint_file_path = output_file_path + ".checkpoint";
+					nlohmann::json checkpoint;
+					checkpoint["Locations"] = locations.size();
+					checkpoint["First"] = first;
+					checkpoint["Last"] = last;
+					checkpoint["Seed"] = m_options.Get<int>("Seed");
+					checkpoint["Compress"] = bCompress ? p.level : 0;
+					checkpoint["Options"] = GetRunOptions(m_options);
+
+					//resume: skip completed locations and remove data written after the checkpoint
+					size_t start = first;
+					bool bResume = false;
+					if (msg && m_options.at("Resume")->isSet() && m_options.Get<int>("Seed") == 0)
+						msg.ajoute("Resume need a fixed seed (-S): a random seed doesn't reproduce the interrupted run");
+
+					if (msg && m_options.at("Resume")->isSet())
 					{
-						pWG->SetSeed(seeds[l]);
-						pWG->SetTarget(locations[l]);
-						msg = pWG->Generate(callback);
+						if (WBSF::FileExists(checkpoint_file_path))
+						{
+							size_t size = 0;
+							msg = LoadCheckpoint(checkpoint_file_path, checkpoint, start, size);
+
+							std::error_code ec;
+							if (msg && (start < first || start > last || std::filesystem::file_size(part_file_path, ec) < size || ec))
+								msg.ajoute("Checkpoint doesn't match the partial output file " + part_file_path);
+
+							if (msg)
+							{
+								std::filesystem::resize_file(part_file_path, size, ec);
+								if (ec)
+									msg.ajoute("Unable to truncate " + part_file_path + ": " + ec.message());
+							}
 
-						//save in memory
-						
-						for (size_t r = 0; r < pWG->GetNbReplications()&&msg; r++)
+							bResume = true;
+							cout << "Resume at location " << start + 1 << " of " << locations.size() << endl;
+						}
+						else
 						{
-							//write info and weather to the stream
-							weather[l][r] = pWG->GetWeather(r);
-						}   // for replication
+							cout << "No checkpoint: start from the beginning" << endl;
+						}
 					}
 
+					//save file
+					WBSF::ofStream file;
 					if (msg)
 					{
-						//std::bitset<CWeatherGenerator::NB_WARNING> warning = m_pWeatherGenerator->GetWarningBits();
-
-						string output_file_path = m_options.GetFilesArg().back();
-
-						// Compress
-						WBSF::ofStream file;
-						std::stringstream sender;
+						std::ios_base::openmode mode = bResume ? ios_base::out | ios_base::app : ios_base::out;
+						msg = file.open(part_file_path, bCompress ? mode | ios_base::binary : mode);
+						if (msg && bResume)
+							file.seekp(0, ios_base::end);//tellp is not at the end after opening in append mode
+					}
 
+					if (msg)
+					{
+						CStatistic::SetVMiss(-999);//set once here: not thread safe
 
-						//save file
-						msg = file.open(output_file_path);
-						if (msg)
+						//locations are generated in parallel: each thread use its own generator. 
+						//Seeds are set before, so results are the same whatever the number of threads.
+						//Each location is written as soon as all previous locations are written.
+						//checkpoint are saved periodically, after the output is flushed. No checkpoint with a random seed: it can't be resumed
+						auto save_checkpoint = [&](size_t nb_written)
 						{
-							CStatistic::SetVMiss(-999);
+							file.flush();
+							checkpoint["Next"] = start + nb_written;
+							checkpoint["Size"] = size_t(file.tellp());
+							ERMsg msg_checkpoint = SaveJSON(checkpoint_file_path, checkpoint);
+							if (!msg_checkpoint)
+								WBSF::PrintMessage(msg_checkpoint);
+						};
+
+						COrderedWriter writer(file, 2 * size_t(CPU), m_options.Get<int>("Seed") != 0 ? std::function<void(size_t)>(save_checkpoint) : nullptr);
+						vector<ERMsg> messages(last - start);
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads( CPU ) if (CPU > 1)
+						for (int i = 0; i < (int)messages.size(); i++)
+						{
+							if (!writer.wait(i))
+								continue;
 
-							boost::iostreams::filtering_streambuf<boost::iostreams::input> out;
-							if (m_options["Compress"]->isSet())
+							size_t l = start + i;
+							try
 							{
-								boost::iostreams::gzip_params p;
-								p.file_name = GetFileName(output_file_path);//"data.csv";
-								out.push(boost::iostreams::gzip_compressor(p));
-							}
-							out.push(sender);
-
+								CWeatherGeneratorPtr pWG = WGs[omp_get_thread_num()];
+								pWG->SetSeed(seeds[l]);
+								pWG->SetTarget(locations[l]);
+								messages[i] = pWG->Generate();
 
-							for (size_t l = 0; l < weather.size() && msg; l++)
-							{
-								for (size_t r = 0; r < weather[l].size() && msg; r++)
+								std::stringstream sender;
+								for (size_t r = 0; r < pWG->GetNbReplications() && messages[i]; r++)
 								{
 									//write info and weather to the stream
-									//const CSimulationPoint& weather = pWG->GetWeather(r);
-									CTM TM = weather[l][r].GetTM();
-									msg = ((CWeatherYears&)weather[l][r]).SaveData(sender, TM, ',');
-
+									const CSimulationPoint& weather = pWG->GetWeather(r);
+									CTM TM = weather.GetTM();
+									messages[i] = ((CWeatherYears&)weather).SaveData(sender, TM, ',');
 								}   // for replication
+
+								if (messages[i])
+								{
+									//members are written without file name: merged shards are the same as the complete run
+									if (bCompress)
+										writer.write(i, GetGZipMember(sender.str(), p));
+									else
+										writer.write(i, sender.str());
+								}
+							}
+							catch (...)
+							{
+								messages[i].ajoute("Unexpected error for location " + locations[l].m_ID);
 							}
 
-							file << sender.str();
-							file.close();
+							if (!messages[i])
+								writer.abort();
 						}
 
+						for (size_t l = 0; l < messages.size(); l++)
+							msg += messages[l];
+
+						file.close();
+
+						std::error_code ec;
+						if (msg)
+						{
+							//the run is complete: the checkpoint is no longer needed
+							std::filesystem::rename(part_file_path, output_file_path, ec);
+							if (ec)
+								msg.ajoute("Unable to rename " + part_file_path + " to " + output_file_path + ": " + ec.message());
+							else
+								std::filesystem::remove(checkpoint_file_path, ec);
+
+							//shard metadata, validated by the merge
+							if (msg && m_options.at("Shard")->isSet())
+							{
+								size_t i = 1;
+								size_t N = 1;
+								m_options.GetShard(i, N);
+
+								nlohmann::json shard = checkpoint;
+								shard.erase("Next");
+								shard.erase("Size");
+								shard["Shard"] = i;
+								shard["NbShards"] = N;
+								msg += SaveJSON(output_file_path + ".shard", shard);
+							}
+						}
+						else if (!WBSF::FileExists(checkpoint_file_path))
+						{
+							//nothing to resume from
+							std::filesystem::remove(part_file_path, ec);
+						}
 					}
 				}
 
@@ -652,7 +975,106 @@ namespace WBSF
 
 
 
-	ERMsg CWeatherGeneratorApp::InitializeWG(CWeatherGeneratorPtr& pWG)const
+	//load the metadata of a shard output
+	static ERMsg LoadShard(const std::string& file_path, nlohmann::json& shard)
+	{
+		ERMsg msg;
+
+		WBSF::ifStream file;
+		msg = file.open(file_path + ".shard");
+		if (msg)
+		{
+			shard = nlohmann::json::parse(file, nullptr, false);
+			file.close();
+
+			bool bValid = shard.is_object();
+			for (const char* key : { "Shard", "NbShards", "Locations", "First", "Last" })
+				bValid = bValid && shard.contains(key) && shard[key].is_number_unsigned();
+			for (const char* key : { "Seed", "Compress", "Options" })
+				bValid = bValid && shard.contains(key);
+
+			if (!bValid)
+				msg.ajoute("Invalid shard metadata: " + file_path + ".shard");
+		}
+
+		return msg;
+	}
+
+	ERMsg CWeatherGeneratorApp::MergeShards()const
+	{
+		ERMsg msg;
+
+		const vector<string>& files = m_options.GetFilesArg();
+		if (files.size() < 2)
+		{
+			msg.ajoute("Invalid input/output. " + to_string(files.size()) + "  file(s) was specify when shards files and output file are needed to merge. ");
+			return msg;
+		}
+
+		size_t nb_shards = files.size() - 1;
+		cout << "Merge " << nb_shards << " shards" << endl;
+
+		//all shards of the same run must be given in order: same locations, seed and options and contiguous locations
+		vector<nlohmann::json> shards(nb_shards);
+		for (size_t i = 0; i < nb_shards && msg; i++)
+			msg += LoadShard(files[i], shards[i]);
+
+		for (size_t i = 0; i < nb_shards && msg; i++)
+		{
+			const nlohmann::json& shard = shards[i];
+			if (shard["Shard"] != i + 1 || shard["NbShards"] != nb_shards)
+				msg.ajoute(files[i] + " is shard " + shard["Shard"].dump() + "/" + shard["NbShards"].dump() + " when shard " + to_string(i + 1) + "/" + to_string(nb_shards) + " is expected");
+
+			for (const char* key : { "Locations", "Seed", "Compress", "Options" })
+			{
+				if (shard[key] != shards[0][key])
+					msg.ajoute(files[i] + " doesn't have the same " + key + " as " + files[0] + ": " + shard[key].dump() + " vs " + shards[0][key].dump());
+			}
+
+			size_t first = shard["First"];
+			size_t expected_first = (i == 0) ? 0 : shards[i - 1]["Last"].get<size_t>();
+			if (first != expected_first || (i + 1 == nb_shards && shard["Last"] != shard["Locations"]))
+				msg.ajoute(files[i] + " locations are not contiguous with the other shards");
+		}
+
+		if (!msg)
+			return msg;
+
+		//shards are concatenated byte by byte: CSV and multi-member gzip are both valid
+		WBSF::ofStream file;
+		msg = file.open(files.back(), ios_base::out | ios_base::binary);
+		for (size_t i = 0; i < nb_shards && msg; i++)
+		{
+			WBSF::ifStream shard;
+			msg = shard.open(files[i], ios_base::in | ios_base::binary);
+			if (msg)
+			{
+				file << shard.rdbuf();
+				shard.close();
+			}
+		}
+
+		if (file.is_open())
+			file.close();
+
+		return msg;
+	}
+
+	int CWeatherGeneratorApp::GetNbCPU()const
+	{
+		if (!m_options.at("Multi")->isSet())
+			return 1;
+
+		int CPU = min(m_options.Get<int>("CPU"), omp_get_max_threads());
+		if (CPU == 0)
+			CPU = omp_get_max_threads();
+		else if (CPU < 0)
+			CPU = max(1, omp_get_max_threads() + CPU);
+
+		return CPU;
+	}
+
+	ERMsg CWeatherGeneratorApp::InitializeWG(vector<CWeatherGeneratorPtr>& WGs, size_t nb_WGs)const
 	{
 		ERMsg msg;
 		CCallback callback;
@@ -661,6 +1083,8 @@ namespace WBSF
 		CNormalsDatabasePtr pNormalDB;
 		CDailyDatabasePtr pDailyDB;
 		CHourlyDatabasePtr pHourlyDB;
+		string daily_name;
+		string hourly_name;
 
 
 		string normal_name = m_options.GetValueArg("NormalsDB")->getValue();
@@ -717,7 +1141,7 @@ namespace WBSF
 
 			if (from_daily)
 			{
-				string daily_name = m_options.GetValueArg("DailyDB")->getValue();
+				daily_name = m_options.GetValueArg("DailyDB")->getValue();
 				if (!WBSF::FileExists(daily_name))
 				{
 					if (!m_global.m_daily_path.empty())
@@ -765,7 +1189,7 @@ namespace WBSF
 			}
 			else if (from_hourly)
 			{
-				string hourly_name = m_options.GetValueArg("HourlyDB")->getValue();
+				hourly_name = m_options.GetValueArg("HourlyDB")->getValue();
 				if (!WBSF::FileExists(hourly_name))
 				{
 					if (!m_global.m_hourly_path.empty())
@@ -815,23 +1239,47 @@ namespace WBSF
 
 		if (msg)
 		{
-			pWG.reset(new CWeatherGenerator);
-			pWG->SetNormalDB(pNormalDB);
-			pWG->SetDailyDB(pDailyDB);
-			pWG->SetHourlyDB(pHourlyDB);
-
-
 			//Load WGInput
 			CWGInput WGInput;
 			msg += m_options.GetWGInput(m_global, WGInput);
 
 			size_t nb_reps = m_options.Get<int>("Reps");
 
-			
-			
-			pWG->SetNbReplications(nb_reps);
-			pWG->SetWGInput(WGInput);
+			//Normals and databases loaded in memory (.gz) are complete once opened here, with their canals and 
+			//search optimization: generators only read them and share them. Databases read from disk 
+			//(.DailyDB, .HourlyDB) load stations on demand in a cache that is not protected against 
+			//concurrent access: each generator has its own instance, with its own cache.
+			bool bDailyFromDisk = pDailyDB && IsEqual(GetFileExtension(daily_name), ".DailyDB");
+			bool bHourlyFromDisk = pHourlyDB && IsEqual(GetFileExtension(hourly_name), ".HourlyDB");
+
+			WGs.resize(max(size_t(1), nb_WGs));
+			for (size_t t = 0; t < WGs.size() && msg; t++)
+			{
+				CDailyDatabasePtr pThreadDailyDB = pDailyDB;
+				if (t > 0 && bDailyFromDisk)
+				{
+					pThreadDailyDB.reset(new CDailyDatabase(int(m_global.m_daily_cache_size)));
+					msg += pThreadDailyDB->Open(daily_name, CDailyDatabase::modeRead, callback, true);
+					if (msg)
+						msg += pThreadDailyDB->OpenSearchOptimization(callback);
+				}
 
+				CHourlyDatabasePtr pThreadHourlyDB = pHourlyDB;
+				if (t > 0 && bHourlyFromDisk)
+				{
+					pThreadHourlyDB.reset(new CHourlyDatabase(int(m_global.m_daily_cache_size)));
+					msg += pThreadHourlyDB->Open(hourly_name, CHourlyDatabase::modeRead, callback, true);
+					if (msg)
+						msg += pThreadHourlyDB->OpenSearchOptimization(callback);
+				}
+
+				WGs[t].reset(new CWeatherGenerator);
+				WGs[t]->SetNormalDB(pNormalDB);
+				WGs[t]->SetDailyDB(pThreadDailyDB);
+				WGs[t]->SetHourlyDB(pThreadHourlyDB);
+				WGs[t]->SetNbReplications(nb_reps);
+				WGs[t]->SetWGInput(WGInput);
+			}
 		}
 
 		return msg;
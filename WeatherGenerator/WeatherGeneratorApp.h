@@ -2,6 +2,7 @@
 #pragma once
 
 #include <deque>
+#include <vector>
 #include <set>
 #include <boost/dynamic_bitset.hpp>
 
@@ -162,6 +163,8 @@ namespace WBSF
 
 		ERMsg GetLoc(const CGlobalData& global, CLocationVector& loc)const;
 		ERMsg GetWGInput(const CGlobalData& global, CWGInput& WGInput)const;
+		ERMsg GetShard(size_t& i, size_t& N)const;
+		ERMsg GetShard(size_t nb_locations, size_t& first, size_t& last)const;
 		
 		//CLocationVector m_loc;
 	};
@@ -210,9 +213,13 @@ namespace WBSF
 	public:
 
 		ERMsg Execute();
+		ERMsg MergeShards()const;
 
+		//number of threads from -M and -C options
+		int GetNbCPU()const;
 
-		ERMsg InitializeWG(CWeatherGeneratorPtr& pWG)const;
+		//one generator per thread. Databases in memory are shared read-only, databases read from disk are opened by generator
+		ERMsg InitializeWG(std::vector<CWeatherGeneratorPtr>& WGs, size_t nb_WGs)const;
 		
 
 